@@ -8,23 +8,65 @@
 #include "nuklear.h"
 #include "nuklear_impl.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <span>
+#include <string>
 
 void audioCallback(void *userdata, SDL_AudioStream *stream, int additional_amount, int) {
     auto ctx = reinterpret_cast<Ctx *>(userdata);
 
-    constexpr auto buf_len = 128;
+    constexpr size_t buf_len = 128;
 
-    while (additional_amount > 0) {
+    // samples still queued in the stream and the device buffer are played before the new ones
+    const auto queued = static_cast<size_t>(std::max(SDL_GetAudioStreamQueued(stream), 0)) / sizeof(float);
+    auto latency = ctx->audio_monitor.record(queued);
+
+    // only what the device asks for is queued, anything more adds latency
+    auto remaining = static_cast<size_t>(std::max(additional_amount, 0)) / sizeof(float);
+
+    while (remaining > 0) {
         float samples[buf_len];
-        ctx->audio.getSamples(samples);
-        SDL_PutAudioStreamData(stream, samples, sizeof(samples));
-        additional_amount -= buf_len;
+        const auto count = std::min(remaining, buf_len);
+
+        latency += count;
+        ctx->audio.getSamples(std::span(samples, count), latency);
+        SDL_PutAudioStreamData(stream, samples, static_cast<int>(count * sizeof(float)));
+        remaining -= count;
     }
 }
 
+SDL_AudioStream *openAudioStream(Ctx &ctx) {
+    const auto config = ctx.audio_config;
+
+    SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, std::to_string(config.buffer_frames).c_str());
+
+    SDL_AudioSpec audio_spec = {
+        .format = SDL_AUDIO_F32,
+        .channels = 1,
+        .freq = static_cast<int>(config.sample_rate),
+    };
+
+    const auto audio_stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &audio_spec, audioCallback, &ctx);
+
+    if (audio_stream == nullptr) {
+        SDL_Log("Error SDL_OpenAudioDeviceStream %s", SDL_GetError());
+        exit(-1);
+    }
+
+    SDL_AudioSpec device_spec;
+    int device_frames = 0;
+
+    if (SDL_GetAudioDeviceFormat(SDL_GetAudioStreamDevice(audio_stream), &device_spec, &device_frames) && device_spec.freq > 0) {
+        ctx.audio_monitor.setDeviceFrames(static_cast<size_t>(device_frames) * config.sample_rate / static_cast<size_t>(device_spec.freq));
+    }
+
+    SDL_ResumeAudioStreamDevice(audio_stream);
+    return audio_stream;
+}
+
 int main() {
     SDL_Window *win;
     SDL_Renderer *renderer;
@@ -77,48 +119,15 @@ int main() {
         nk_style_set_font(ctx, &font->handle);
     }
 
-    float refresh_rate = 60.f;
-    {
-        int display_count = 0;
-        const auto displays = SDL_GetDisplays(&display_count);
-        const auto win_display = SDL_GetDisplayForWindow(win);
-
-        if (win_display) {
-            const auto mode = SDL_GetDesktopDisplayMode(win_display);
-
-            if (mode) {
-                refresh_rate = mode->refresh_rate;
-            }
-        } else if (display_count > 0) {
-            const auto mode = SDL_GetDesktopDisplayMode(displays[0]);
-
-            if (mode) {
-                refresh_rate = mode->refresh_rate;
-            }
-        }
-    }
-
     auto app_ctx = Ctx{
-        .audio = audio::AudioSystem(44100, refresh_rate),
+        .audio = audio::AudioSystem(audio::DeviceConfig{}.sample_rate),
         .nk = ctx,
         .window_size_x = 640,
         .window_size_y = 480,
     };
 
-    SDL_AudioSpec audio_spec = {
-        .format = SDL_AUDIO_F32,
-        .channels = 1,
-        .freq = 44100,
-    };
-
-    const auto audio_stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &audio_spec, audioCallback, &app_ctx);
-
-    if (audio_stream == nullptr) {
-        SDL_Log("Error SDL_OpenAudioDeviceStream %s", SDL_GetError());
-        exit(-1);
-    }
-
-    SDL_ResumeAudioStreamDevice(audio_stream);
+    auto audio_config = app_ctx.audio_config;
+    auto audio_stream = openAudioStream(app_ctx);
 
     ui::style::setup(app_ctx);
 
@@ -140,6 +149,23 @@ int main() {
     auto tp = std::chrono::steady_clock::now();
 
     while (app_ctx.running) {
+        // the audio thread is gone while the sample rate changes, everything rendered for the old one is redone
+        if (app_ctx.audio_config != audio_config) {
+            SDL_DestroyAudioStream(audio_stream);
+
+            if (app_ctx.audio_config.sample_rate != audio_config.sample_rate) {
+                app_ctx.audio.stopAll();
+                app_ctx.audio.setSampleRate(app_ctx.audio_config.sample_rate);
+
+                for (const auto &node : app_ctx.nodes) {
+                    node->makeDirty();
+                }
+            }
+
+            audio_config = app_ctx.audio_config;
+            audio_stream = openAudioStream(app_ctx);
+        }
+
         float mouse_diff_x = 0, mouse_diff_y = 0;
         bool mouse_grid_stop = false;
         {
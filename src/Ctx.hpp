@@ -3,6 +3,8 @@
 #include "nuklear.h"
 
 #include <audio/audio.hpp>
+#include <audio/device.hpp>
+#include <engine/thread_pool.hpp>
 #include <nodes/nodes.hpp>
 
 #include <cstddef>
@@ -12,6 +14,10 @@ struct Ctx {
     bool running = true;
 
     audio::AudioSystem audio;
+    // requested in the UI, the main loop reopens the device when it differs from the open one
+    audio::DeviceConfig audio_config{};
+    audio::DeviceMonitor audio_monitor{};
+    engine::ThreadPool thread_pool{};
 
     nk_context *nk;
     size_t window_size_x;
@@ -1,99 +1,486 @@
 #include "audio.hpp"
 
-#include <chrono>
+#include <algorithm>
 #include <cmath>
+#include <limits>
+#include <vector>
 
 namespace audio {
-void AudioSystem::getSamples(std::span<types::OutFloat> samples) {
-    std::lock_guard lck(m_mtx);
+namespace {
+size_t loopEnd(const Clip &clip, const AudioSystem::Loop &loop) { return loop.end == 0 ? clip.size() : std::min(loop.end, clip.size()); }
 
-    if (!m_playing) {
-        std::ranges::fill(samples, 0.f);
-        m_volume = m_target_volume;
-        return;
+// Linear fade from the end of the loop to the samples following its beginning, they are played instead of the last
+// samples and the loop continues after the faded ones. Empty if the samples are not rendered yet.
+Clip makeCrossfade(const Clip &clip, const AudioSystem::Loop &loop) {
+    const auto end = loopEnd(clip, loop);
+
+    if (loop.style != AudioSystem::LoopingStyle::FORWARD || loop.begin >= end) {
+        return {};
+    }
+
+    const auto length = std::min(loop.crossfade, (end - loop.begin) / 2);
+    const auto samples = clip.samples();
+
+    if (length == 0 || samples.size() < end) {
+        return {};
+    }
+
+    std::vector<types::Float> fade(length);
+
+    for (size_t i = 0; i < length; ++i) {
+        const auto t = (static_cast<types::Float>(i) + 0.5f) / static_cast<types::Float>(length);
+        fade[i] = samples[end - length + i] * (1.f - t) + samples[loop.begin + i] * t;
+    }
+
+    return Clip(std::move(fade));
+}
+
+// Moves the cursor past the sample it points at, playback and the lookup of the audible sample share it. Loop points
+// are resolved against the clip every time, a cursor past the loop end plays to the end of the clip. Returns false
+// once the cursor is past the end of the clip.
+bool advance(size_t &cursor, bool &reverse, const AudioSystem::Loop &loop, size_t end, size_t fade, size_t size) {
+    if (loop.style == AudioSystem::LoopingStyle::NO_LOOPING || loop.begin >= end || cursor >= end) {
+        if (cursor >= size) {
+            return false;
+        }
+
+        cursor += 1;
+        return true;
+    }
+
+    if (loop.style == AudioSystem::LoopingStyle::PING_PONG) {
+        if (reverse && cursor <= loop.begin) {
+            reverse = false;
+        } else if (!reverse && cursor + 1 >= end) {
+            reverse = true;
+        }
+
+        // the cursor turns around before it moves, so it never leaves the loop and a single sample is held
+        if (reverse ? cursor > loop.begin : cursor + 1 < end) {
+            cursor = reverse ? cursor - 1 : cursor + 1;
+        }
+
+        return true;
     }
 
+    cursor += 1;
+
+    if (cursor == end) {
+        cursor = loop.begin + fade;
+    }
+
+    return true;
+}
+} // namespace
+
+void AudioSystem::getSamples(std::span<types::OutFloat> samples, size_t latency) {
+    applyCommands();
+
     static constexpr auto volume_change = 1e-3f;
+    static constexpr auto limiter_release = 1e-4f;
 
-    for (auto &s : samples) {
-        m_volume = m_volume * (1.f - volume_change) + m_target_volume * volume_change;
+    for (size_t offset = 0; offset < samples.size(); offset += mix_block) {
+        const auto n = std::min(mix_block, samples.size() - offset);
+        const auto mix = std::span(m_mix_buffer).first(n);
+        const auto buffer = std::span(m_voice_buffer).first(n);
 
-        if (m_clip_cursor < m_clip.size()) {
-            s = std::clamp(m_clip[m_clip_cursor++], types::Float(-1), types::Float(1)) * m_volume;
-            continue;
+        std::ranges::fill(mix, 0.f);
+
+        for (size_t v = 0; v < voice_count; ++v) {
+            auto &voice = m_voices[v];
+            const auto target_volume = m_states[v].target_volume.load(std::memory_order_relaxed);
+
+            if (!voice.playing) {
+                mark(voice, {.time = m_time, .cursor = voice.cursor, .reverse = voice.reverse});
+                voice.volume = target_volume;
+                continue;
+            }
+
+            const auto cursor = voice.cursor;
+            const auto reverse = voice.reverse;
+            const auto moving = render(voice, buffer);
+
+            mark(voice, {.time = m_time, .cursor = cursor, .reverse = reverse, .moving = moving});
+
+            // the one-pole volume ramp is followed linearly within a block, which keeps the mix loop vectorizable
+            const auto volume = voice.volume;
+            const auto end_volume = target_volume + (volume - target_volume) * std::pow(1.f - volume_change, static_cast<types::Float>(n));
+            const auto step = (end_volume - volume) / static_cast<types::Float>(n);
+
+            for (size_t i = 0; i < n; ++i) {
+                mix[i] += std::clamp(buffer[i], types::Float(-1), types::Float(1)) * (volume + step * static_cast<types::Float>(i + 1));
+            }
+
+            voice.volume = end_volume;
         }
 
-        s = 0.f;
-        m_playing = false;
+        // peak limiter with instant attack, it stays transparent while the mix is within [-1, 1]
+        for (size_t i = 0; i < n; ++i) {
+            const auto peak = std::abs(mix[i]);
+
+            m_limiter_gain += (1.f - m_limiter_gain) * limiter_release;
+
+            if (peak * m_limiter_gain > 1.f) {
+                m_limiter_gain = 1.f / peak;
+            }
+
+            samples[offset + i] = std::clamp(mix[i] * m_limiter_gain, types::Float(-1), types::Float(1));
+        }
+
+        m_time += n;
     }
+
+    publish(latency);
 }
 
-void AudioSystem::ignoreNextFeedbackTimer() { m_feedback_ignore_next = true; }
+// Returns false while the voice waits for a growing clip.
+bool AudioSystem::render(Voice &voice, std::span<types::Float> output) {
+    if (voice.source) {
+        voice.source->render(output);
+        voice.cursor += output.size();
+        return true;
+    }
 
-void AudioSystem::getSampleFeedback(std::span<types::Float> samples, std::optional<types::Float> sync) {
-    std::lock_guard lck(m_mtx);
-    std::ranges::fill(samples, 0.f);
+    const auto clip = voice.clip.samples();
+
+    // a clip still being rendered waits in silence until enough samples are ahead of the cursor
+    if (clip.size() < voice.clip.size() && clip.size() < voice.cursor + output.size() + m_sample_rate * headroom_ms / 1000) {
+        std::ranges::fill(output, 0.f);
+        return false;
+    }
+
+    for (auto &s : output) {
+        s = voice.playing ? nextSample(voice, clip) : 0.f;
+    }
+
+    return true;
+}
+
+types::Float AudioSystem::nextSample(Voice &voice, std::span<const types::Float> clip) {
+    const auto end = loopEnd(voice.clip, voice.loop);
+    const auto fade = voice.crossfade.samples();
+    const auto cursor = voice.cursor;
+
+    if (!advance(voice.cursor, voice.reverse, voice.loop, end, fade.size(), clip.size())) {
+        voice.playing = false;
+        return 0.f;
+    }
+
+    // the crossfade replaces the last samples of a forward loop
+    if (!fade.empty() && cursor < end && cursor >= end - fade.size()) {
+        return fade[cursor - (end - fade.size())];
+    }
+
+    return clip[cursor];
+}
+
+void AudioSystem::mark(Voice &voice, Mark mark) {
+    voice.last_mark = (voice.last_mark + 1) & (mark_count - 1);
+    voice.marks[voice.last_mark] = mark;
+}
+
+// Cursor of the voice when the sample mixed at the time was rendered. It is replayed from the mark of its block, a
+// time older than all marks gets the oldest one.
+size_t AudioSystem::locate(const Voice &voice, uint64_t time) const {
+    auto mark = voice.marks[voice.last_mark];
+
+    for (size_t i = 1; i < mark_count && mark.time > time; ++i) {
+        mark = voice.marks[(voice.last_mark - i) & (mark_count - 1)];
+    }
+
+    if (!mark.moving || time <= mark.time) {
+        return mark.cursor;
+    }
+
+    const auto steps = std::min<uint64_t>(time - mark.time, mix_block);
+
+    if (voice.source) {
+        return mark.cursor + steps;
+    }
+
+    const auto end = loopEnd(voice.clip, voice.loop);
+    const auto fade = voice.crossfade.samples().size();
+    const auto size = voice.clip.samples().size();
+
+    for (uint64_t i = 0; i < steps && advance(mark.cursor, mark.reverse, voice.loop, end, fade, size); ++i) {
+    }
+
+    return mark.cursor;
+}
+
+void AudioSystem::publish(size_t latency) {
+    const auto audible = m_time > latency ? m_time - latency : 0;
+
+    for (size_t v = 0; v < voice_count; ++v) {
+        const auto &voice = m_voices[v];
+        auto &state = m_states[v];
+
+        state.cursor.store(voice.cursor, std::memory_order_release);
+        state.audible.store(locate(voice, audible), std::memory_order_release);
+        state.playing.store(voice.playing, std::memory_order_release);
+    }
+}
 
-    const auto tp = std::chrono::steady_clock::now();
-    const auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(tp - m_feedback_tp).count();
-    m_feedback_tp = tp;
+// Clips and sources are replaced only when the old ones can be handed back, releasing them here could free memory.
+void AudioSystem::applyCommands() {
+    while (const auto command = m_commands.peek()) {
+        auto &voice = m_voices[command->voice];
 
-    if (!m_feedback_ignore_next) {
-        static constexpr auto adjust_ratio = 1.f / 256.f;
-        m_feedback_rate = m_feedback_rate * (1.f - adjust_ratio) + (elapsed_ns * adjust_ratio);
+        switch (command->type) {
+        case Command::Type::SET_CLIP:
+        case Command::Type::SET_SOURCE:
+            if (m_retired.full()) {
+                return;
+            }
+
+            // a crossfade belongs to a single clip, the loop of the new one comes with its own
+            if (voice.clip || voice.source || voice.crossfade) {
+                (void)m_retired.push({
+                    .clip = std::move(voice.clip),
+                    .source = std::move(voice.source),
+                    .crossfade = std::move(voice.crossfade),
+                });
+            }
+
+            voice.clip = std::move(command->clip);
+            voice.source = std::move(command->source);
+            break;
+        case Command::Type::SET_LOOP:
+            if (m_retired.full()) {
+                return;
+            }
+
+            if (voice.crossfade) {
+                (void)m_retired.push({.crossfade = std::move(voice.crossfade)});
+            }
+
+            voice.loop = command->loop;
+            voice.crossfade = std::move(command->crossfade);
+            break;
+        case Command::Type::PLAY:
+            voice.cursor = command->position;
+            voice.playing = true;
+            voice.reverse = false;
+            break;
+        case Command::Type::STOP:
+            voice.cursor = 0;
+            voice.playing = false;
+            voice.reverse = false;
+            break;
+        }
+
+        (void)m_commands.pop();
+    }
+}
+
+void AudioSystem::send(Command command) {
+    m_backlog.push_back(std::move(command));
+    collect();
+}
+
+// Releases retired clips and forwards commands which did not fit in the queue, called regularly from the UI thread.
+void AudioSystem::collect() {
+    while (m_retired.pop()) {
+    }
+
+    while (!m_backlog.empty() && m_commands.push(std::move(m_backlog.front()))) {
+        m_backlog.pop_front();
+    }
+
+    for (size_t v = 0; v < voice_count; ++v) {
+        const auto &owner = m_owners[v];
+
+        if (owner.crossfade_pending && owner.clip.samples().size() >= loopEnd(owner.clip, owner.loop)) {
+            sendLoop(v);
+        }
+    }
+}
+
+size_t AudioSystem::findVoice(const void *parent) const {
+    if (parent == nullptr) {
+        return no_voice;
+    }
+
+    const auto it = std::ranges::find(m_owners, parent, &VoiceOwner::parent);
+    return it == m_owners.end() ? no_voice : static_cast<size_t>(it - m_owners.begin());
+}
+
+size_t AudioSystem::claimVoice(const void *parent) {
+    if (const auto v = findVoice(parent); v != no_voice) {
+        return v;
     }
 
-    m_feedback_ignore_next = false;
-    const auto samples_per_ns = m_sample_rate * 1e-9f;
-    m_feedback_cursor += m_feedback_rate * samples_per_ns;
+    // a free voice, else the stopped or playing one started first
+    auto claimed = no_voice;
+    auto claimed_started = std::numeric_limits<uint64_t>::max();
+    auto claimed_playing = true;
 
-    if (!m_playing) {
+    for (size_t v = 0; v < voice_count; ++v) {
+        const auto &owner = m_owners[v];
+
+        if (owner.parent == nullptr) {
+            claimed = v;
+            break;
+        }
+
+        const auto playing = m_states[v].playing.load(std::memory_order_acquire);
+
+        if ((claimed_playing && !playing) || (claimed_playing == playing && owner.started < claimed_started)) {
+            claimed = v;
+            claimed_started = owner.started;
+            claimed_playing = playing;
+        }
+    }
+
+    auto &owner = m_owners[claimed];
+
+    if (owner.parent != nullptr) {
+        send({.type = Command::Type::STOP, .voice = claimed});
+    }
+
+    owner = VoiceOwner{};
+    owner.parent = parent;
+    send({.type = Command::Type::SET_LOOP, .voice = claimed});
+    m_states[claimed].target_volume.store(1.f, std::memory_order_relaxed);
+
+    return claimed;
+}
+
+const Clip &AudioSystem::currentClip(const void *parent) const {
+    static const Clip none;
+    const auto v = findVoice(parent);
+    return v == no_voice ? none : m_owners[v].clip;
+}
+
+const Source *AudioSystem::currentSource(const void *parent) const {
+    const auto v = findVoice(parent);
+    return v == no_voice ? nullptr : m_owners[v].source;
+}
+
+const AudioSystem::Loop &AudioSystem::currentLoop(const void *parent) const {
+    static const Loop none;
+    const auto v = findVoice(parent);
+    return v == no_voice ? none : m_owners[v].loop;
+}
+
+bool AudioSystem::isPlaying(const void *parent) const {
+    const auto v = findVoice(parent);
+    return v != no_voice && m_states[v].playing.load(std::memory_order_acquire);
+}
+
+size_t AudioSystem::playbackCursor(const void *parent) const {
+    const auto v = findVoice(parent);
+    return v == no_voice ? 0 : m_states[v].cursor.load(std::memory_order_acquire);
+}
+
+size_t AudioSystem::audibleCursor(const void *parent) const {
+    const auto v = findVoice(parent);
+    return v == no_voice ? 0 : m_states[v].audible.load(std::memory_order_acquire);
+}
+
+void AudioSystem::getSampleFeedback(const void *parent, std::span<types::Float> samples, std::optional<types::Float> sync) {
+    collect();
+    std::ranges::fill(samples, 0.f);
+
+    if (!isPlaying(parent)) {
         return;
     }
 
-    const auto cursor = [this, sync] {
+    const auto clip = currentClip(parent).samples();
+
+    const auto cursor = [this, parent, sync] {
+        const auto audible = static_cast<int64_t>(audibleCursor(parent));
+
         if (sync) {
-            const auto len = m_sample_rate / *sync;
-            return static_cast<int64_t>(m_feedback_cursor - std::fmod(m_feedback_cursor, len));
+            const auto len = static_cast<double>(m_sample_rate) / *sync;
+            return audible - static_cast<int64_t>(std::fmod(static_cast<double>(audible), len));
         }
 
-        return static_cast<int64_t>(m_feedback_cursor);
+        return audible;
     }();
 
     const auto i_start = cursor - static_cast<int64_t>(samples.size());
     const auto i_end = cursor;
 
     for (int64_t i = i_start, d = 0; i < i_end; ++i, ++d) {
-        if (i < 0 || i >= static_cast<int64_t>(m_clip.size())) {
+        if (i < 0 || i >= static_cast<int64_t>(clip.size())) {
             continue;
         }
 
-        samples[d] = std::clamp(m_clip[i], types::Float(-1), types::Float(1));
+        samples[d] = std::clamp(clip[i], types::Float(-1), types::Float(1));
     }
 }
 
-void AudioSystem::setVolume(types::Float value) {
-    std::lock_guard lck(m_mtx);
-    m_target_volume = value;
+void AudioSystem::setClip(Clip clip, const void *parent) {
+    const auto v = claimVoice(parent);
+    auto &owner = m_owners[v];
+
+    owner.clip = clip;
+    owner.source = nullptr;
+    send({.type = Command::Type::SET_CLIP, .voice = v, .clip = std::move(clip)});
+
+    if (owner.loop.style != LoopingStyle::NO_LOOPING) {
+        sendLoop(v);
+    }
 }
 
-void AudioSystem::setClip(std::vector<types::Float> data, const void *parent) {
-    std::lock_guard lck(m_mtx);
-    m_clip_parent = parent;
-    m_clip = std::move(data);
+void AudioSystem::setSource(std::unique_ptr<Source> source, const void *parent) {
+    const auto v = claimVoice(parent);
+    auto &owner = m_owners[v];
+
+    owner.clip = {};
+    owner.source = source.get();
+    send({.type = Command::Type::SET_SOURCE, .voice = v, .source = std::move(source)});
 }
 
-void AudioSystem::play(size_t start) {
-    std::lock_guard lck(m_mtx);
-    m_clip_cursor = start;
-    m_feedback_cursor = 0;
-    m_playing = true;
-    m_loops = 0;
+void AudioSystem::setVolume(types::Float value, const void *parent) {
+    if (const auto v = findVoice(parent); v != no_voice) {
+        m_states[v].target_volume.store(value, std::memory_order_relaxed);
+    }
+}
+
+void AudioSystem::setLoop(Loop loop, const void *parent) {
+    if (const auto v = findVoice(parent); v != no_voice) {
+        m_owners[v].loop = loop;
+        sendLoop(v);
+    }
+}
+
+void AudioSystem::sendLoop(size_t voice) {
+    auto &owner = m_owners[voice];
+    auto crossfade = makeCrossfade(owner.clip, owner.loop);
+
+    owner.crossfade_pending = owner.loop.style == LoopingStyle::FORWARD && owner.loop.crossfade > 0 && !crossfade;
+    send({.type = Command::Type::SET_LOOP, .voice = voice, .loop = owner.loop, .crossfade = std::move(crossfade)});
+}
+
+void AudioSystem::play(const void *parent, size_t start) {
+    if (const auto v = findVoice(parent); v != no_voice) {
+        m_owners[v].started = ++m_started;
+        send({.type = Command::Type::PLAY, .voice = v, .position = start});
+    }
 }
 
-void AudioSystem::stop() {
-    std::lock_guard lck(m_mtx);
-    m_clip_cursor = 0;
-    m_playing = false;
+void AudioSystem::stop(const void *parent) {
+    if (const auto v = findVoice(parent); v != no_voice) {
+        send({.type = Command::Type::STOP, .voice = v});
+    }
+}
+
+void AudioSystem::stopAll() {
+    for (size_t v = 0; v < voice_count; ++v) {
+        if (m_owners[v].parent != nullptr) {
+            send({.type = Command::Type::STOP, .voice = v});
+        }
+    }
+}
+
+void AudioSystem::release(const void *parent) {
+    if (const auto v = findVoice(parent); v != no_voice) {
+        // an empty clip retires the current clip, source and crossfade of the voice
+        send({.type = Command::Type::STOP, .voice = v});
+        send({.type = Command::Type::SET_CLIP, .voice = v});
+        m_owners[v] = VoiceOwner{};
+    }
 }
 } // namespace audio
@@ -1,16 +1,28 @@
 #pragma once
 
+#include "clip.hpp"
+#include "queue.hpp"
+#include "source.hpp"
+
 #include <types.hpp>
 
-#include <chrono>
-#include <mutex>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
 #include <span>
-#include <vector>
 
 namespace audio {
+/// Mixes a fixed number of voices, each playing a clip or a live source for the parent owning it. Voices are
+/// addressed by their parent, so several outputs play side by side.
+/// Playback state is owned by the audio thread, the UI thread talks to it only through a command queue and atomics,
+/// so `getSamples` never blocks or allocates. All other methods are meant for a single UI thread.
 struct AudioSystem {
-    AudioSystem(size_t sample_rate, types::Float target_frame_rate) //
-        : m_sample_rate(sample_rate), m_feedback_rate(1e9f / target_frame_rate) {}
+    static constexpr size_t voice_count = 16;
+
+    AudioSystem(size_t sample_rate) : m_sample_rate(sample_rate) {}
 
     enum class LoopingStyle {
         NO_LOOPING,
@@ -18,33 +30,154 @@ struct AudioSystem {
         PING_PONG,
     };
 
-    void getSamples(std::span<types::OutFloat> samples);
+    /// Part of the clip played repeatedly once the cursor reaches it, an end of 0 is the end of the clip.
+    /// A forward loop may blend its last samples into the ones following its beginning, ping-pong needs no crossfade.
+    struct Loop {
+        LoopingStyle style = LoopingStyle::NO_LOOPING;
+        size_t begin = 0;
+        size_t end = 0;
+        size_t crossfade = 0;
+
+        bool operator==(const Loop &) const = default;
+    };
+
+    /// Latency is the number of samples queued for the device ahead of these ones, it tells which sample is audible.
+    void getSamples(std::span<types::OutFloat> samples, size_t latency = 0);
     size_t getSampleRate() const { return m_sample_rate; };
-    const void *currentParrent() const { return m_clip_parent; }
+    /// Only while no audio thread runs, clips and sources of the old rate play at the wrong pitch.
+    void setSampleRate(size_t sample_rate) { m_sample_rate = sample_rate; }
+
+    /// A parent keeps its voice until another one needs a voice and none is free.
+    bool hasVoice(const void *parent) const { return findVoice(parent) != no_voice; }
+    const Clip &currentClip(const void *parent) const;
+    const Source *currentSource(const void *parent) const;
+    const Loop &currentLoop(const void *parent) const;
+
+    /// Last state published by the audio thread, the cursor of a source counts samples played since play().
+    bool isPlaying(const void *parent) const;
+    size_t playbackCursor(const void *parent) const;
+    /// Position of the sample leaving the device now, the latency is traced back through the loops played since.
+    size_t audibleCursor(const void *parent) const;
 
-    void ignoreNextFeedbackTimer();
-    void getSampleFeedback(std::span<types::Float> samples, std::optional<types::Float> sync);
+    /// Fills samples with the clip just before the audible cursor, a sync frequency aligns the window to its period.
+    void getSampleFeedback(const void *parent, std::span<types::Float> samples, std::optional<types::Float> sync);
 
-    void setVolume(types::Float);
-    void setClip(std::vector<types::Float>, const void *parent);
-    void play(size_t start = 0);
-    void stop();
+    /// A clip may still be growing, playback then starts once enough of it is rendered ahead of the cursor.
+    /// Takes a voice for a parent without one, a stopped voice or else the one started first is taken over.
+    void setClip(Clip, const void *parent);
+    /// Replaces the clip with a live source, a playing stream switches to it at the next callback.
+    void setSource(std::unique_ptr<Source>, const void *parent);
+
+    // parents without a voice are ignored
+
+    /// Volume changes are ramped, so they never click.
+    void setVolume(types::Float, const void *parent);
+    /// Applies to the current clip and the ones set later. The crossfade is prepared here, for a growing clip
+    /// as soon as the end of the loop is rendered.
+    void setLoop(Loop, const void *parent);
+    void play(const void *parent, size_t start = 0);
+    void stop(const void *parent);
+    void stopAll();
+    /// Stops and frees the voice of a parent about to be destroyed, so no later object at its address inherits it.
+    /// Its clip or source is released on the UI thread once the audio thread hands it back.
+    void release(const void *parent);
 
 private:
-    std::mutex m_mtx;
+    struct Command {
+        enum class Type { SET_CLIP, SET_SOURCE, SET_LOOP, PLAY, STOP };
+
+        Type type = Type::STOP;
+        size_t voice = 0;
+        Clip clip{};
+        std::unique_ptr<Source> source{};
+        size_t position = 0;
+        Loop loop{};
+        // replaces the samples at the end of a forward loop
+        Clip crossfade{};
+    };
+
+    // audio thread, cursor of a voice at the start of a mix block
+    struct Mark {
+        uint64_t time = 0;
+        size_t cursor = 0;
+        bool reverse = false;
+        // false while the voice is stopped or waits for a growing clip
+        bool moving = false;
+    };
+
+    // marks cover the latency of the device, loops make the cursor of the audible sample differ from a fixed lag
+    static constexpr size_t mark_count = 64;
+
+    // audio thread
+    struct Voice {
+        Clip clip;
+        std::unique_ptr<Source> source;
+        Loop loop;
+        Clip crossfade;
+        types::Float volume = 1.f;
+        size_t cursor = 0;
+        bool playing = false;
+        bool reverse = false;
+        std::array<Mark, mark_count> marks{};
+        size_t last_mark = 0;
+    };
+
+    // shared between threads, written by the audio thread except for the target volume
+    struct alignas(64) VoiceState {
+        std::atomic<types::Float> target_volume = 1.f;
+        std::atomic<size_t> cursor = 0;
+        std::atomic<size_t> audible = 0;
+        std::atomic<bool> playing = false;
+    };
+
+    // UI thread, the last reference to a clip is always dropped here
+    struct VoiceOwner {
+        const void *parent = nullptr;
+        Clip clip;
+        const Source *source = nullptr;
+        Loop loop;
+        bool crossfade_pending = false;
+        uint64_t started = 0;
+    };
+
+    static constexpr size_t no_voice = voice_count;
+
+    size_t findVoice(const void *parent) const;
+    size_t claimVoice(const void *parent);
+
+    bool render(Voice &, std::span<types::Float> output);
+    types::Float nextSample(Voice &, std::span<const types::Float> clip);
+    void mark(Voice &, Mark);
+    size_t locate(const Voice &, uint64_t time) const;
+    void publish(size_t latency);
+    void sendLoop(size_t voice);
+    void send(Command);
+    void collect();
+    void applyCommands();
+
+    // samples of a growing clip buffered ahead of the cursor before it plays
+    static constexpr size_t headroom_ms = 50;
+    // voices are mixed in blocks of this size
+    static constexpr size_t mix_block = 128;
+
     size_t m_sample_rate;
 
-    types::Float m_target_volume = 1.f;
-    types::Float m_volume = 1.f;
-    std::vector<types::Float> m_clip;
-    const void *m_clip_parent = nullptr;
-    size_t m_clip_cursor = 0;
-    size_t m_loops = 0;
-    bool m_playing = false;
-
-    std::chrono::steady_clock::time_point m_feedback_tp = std::chrono::steady_clock::now();
-    types::Float m_feedback_cursor = 0;
-    types::Float m_feedback_rate;
-    bool m_feedback_ignore_next = true;
+    // shared between threads
+    SpscQueue<Command, 64> m_commands;
+    SpscQueue<Command, 64> m_retired;
+    std::array<VoiceState, voice_count> m_states;
+
+    // audio thread
+    std::array<Voice, voice_count> m_voices;
+    std::array<types::Float, mix_block> m_voice_buffer{};
+    std::array<types::Float, mix_block> m_mix_buffer{};
+    types::Float m_limiter_gain = 1.f;
+    // samples mixed since the start
+    uint64_t m_time = 0;
+
+    // UI thread
+    std::deque<Command> m_backlog;
+    std::array<VoiceOwner, voice_count> m_owners;
+    uint64_t m_started = 0;
 };
 } // namespace audio
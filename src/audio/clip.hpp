@@ -0,0 +1,67 @@
+#pragma once
+
+#include <types.hpp>
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace audio {
+/// Immutable reference counted samples, copies share one buffer so a render can be handed to the player, the scope
+/// and caches without copying it. A clip filled by a ClipWriter grows while it is shared, samples already available
+/// never change.
+struct Clip {
+    Clip() = default;
+    explicit Clip(std::vector<types::Float> samples) : m_buffer(std::make_shared<Buffer>(std::move(samples))) {}
+
+    /// Samples available so far, safe to call while a writer fills the clip.
+    std::span<const types::Float> samples() const {
+        return m_buffer ? std::span(m_buffer->samples).first(m_buffer->ready.load(std::memory_order_acquire)) : std::span<const types::Float>();
+    }
+
+    /// Length of the complete clip.
+    size_t size() const { return m_buffer ? m_buffer->samples.size() : 0; }
+    bool empty() const { return size() == 0; }
+    bool isComplete() const { return samples().size() == size(); }
+
+    bool operator==(const Clip &other) const { return m_buffer == other.m_buffer; }
+    explicit operator bool() const { return m_buffer != nullptr; }
+
+private:
+    friend struct ClipWriter;
+
+    struct Buffer {
+        explicit Buffer(std::vector<types::Float> samples) : samples(std::move(samples)), ready(this->samples.size()) {}
+
+        std::vector<types::Float> samples;
+        std::atomic<size_t> ready;
+    };
+
+    std::shared_ptr<Buffer> m_buffer;
+};
+
+/// Renders a clip of known length in place, committed samples become visible to all copies of the clip.
+struct ClipWriter {
+    explicit ClipWriter(size_t length) {
+        m_clip.m_buffer = std::make_shared<Clip::Buffer>(std::vector<types::Float>(length));
+        m_clip.m_buffer->ready.store(0, std::memory_order_relaxed);
+    }
+
+    const Clip &clip() const { return m_clip; }
+
+    /// Samples not committed yet, only the writer may touch them.
+    std::span<types::Float> pending() { return std::span(m_clip.m_buffer->samples).subspan(m_committed); }
+
+    void commit(size_t count) {
+        assert(m_committed + count <= m_clip.size());
+        m_committed += count;
+        m_clip.m_buffer->ready.store(m_committed, std::memory_order_release);
+    }
+
+private:
+    Clip m_clip;
+    size_t m_committed = 0;
+};
+} // namespace audio
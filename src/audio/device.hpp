@@ -0,0 +1,94 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace audio {
+/// Setup of the output device, the device is reopened whenever it changes.
+struct DeviceConfig {
+    static constexpr std::array<size_t, 3> sample_rates = {44100, 48000, 96000};
+    static constexpr std::array<size_t, 6> buffer_sizes = {64, 128, 256, 512, 1024, 2048};
+
+    size_t sample_rate = 44100;
+    /// Requested size of the device buffer in sample frames, the device may pick a different one.
+    size_t buffer_frames = 256;
+
+    bool operator==(const DeviceConfig &) const = default;
+};
+
+/// Timing of the device callback, recorded on the audio thread and read on the UI thread without locks.
+/// Statistics are published once per window of callbacks, so they stay readable while the UI redraws.
+struct DeviceMonitor {
+    struct Stats {
+        std::chrono::nanoseconds period{};
+        std::chrono::nanoseconds max_period{};
+        /// Samples between the newest sample handed to the device and the one being heard.
+        size_t latency = 0;
+        size_t device_frames = 0;
+    };
+
+    /// Before the device starts, size of its buffer at the sample rate of the stream.
+    void setDeviceFrames(size_t frames) noexcept { m_device_frames.store(frames, std::memory_order_relaxed); }
+
+    /// Audio thread, once per callback with the number of samples still queued for the device. Returns the latency
+    /// of the first sample written by the callback.
+    size_t record(size_t queued) noexcept {
+        const auto now = std::chrono::steady_clock::now();
+        const auto latency = queued + m_device_frames.load(std::memory_order_relaxed);
+
+        if (m_last != std::chrono::steady_clock::time_point{}) {
+            const auto period = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_last).count();
+
+            m_period_sum += period;
+            m_period_max = std::max(m_period_max, period);
+            m_latency_sum += latency;
+            m_count += 1;
+        }
+
+        m_last = now;
+
+        if (m_count == window) {
+            m_period.store(m_period_sum / window, std::memory_order_relaxed);
+            m_max_period.store(m_period_max, std::memory_order_relaxed);
+            m_latency.store(m_latency_sum / window, std::memory_order_relaxed);
+
+            m_period_sum = 0;
+            m_period_max = 0;
+            m_latency_sum = 0;
+            m_count = 0;
+        }
+
+        return latency;
+    }
+
+    /// UI thread, averages and the longest period of the last complete window.
+    Stats stats() const noexcept {
+        return {
+            .period = std::chrono::nanoseconds(m_period.load(std::memory_order_relaxed)),
+            .max_period = std::chrono::nanoseconds(m_max_period.load(std::memory_order_relaxed)),
+            .latency = m_latency.load(std::memory_order_relaxed),
+            .device_frames = m_device_frames.load(std::memory_order_relaxed),
+        };
+    }
+
+private:
+    static constexpr size_t window = 64;
+
+    // shared between threads
+    std::atomic<int64_t> m_period = 0;
+    std::atomic<int64_t> m_max_period = 0;
+    std::atomic<size_t> m_latency = 0;
+    std::atomic<size_t> m_device_frames = 0;
+
+    // audio thread
+    std::chrono::steady_clock::time_point m_last{};
+    int64_t m_period_sum = 0;
+    int64_t m_period_max = 0;
+    size_t m_latency_sum = 0;
+    size_t m_count = 0;
+};
+} // namespace audio
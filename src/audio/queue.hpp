@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+namespace audio {
+/// Bounded wait-free queue for exactly one producer thread and one consumer thread, it never allocates.
+template <typename T, size_t N> struct SpscQueue {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+
+    /// Producer side, returns false if the queue is full.
+    [[nodiscard]] bool push(const T &value) noexcept { return emplace(value); }
+
+    /// Producer side, the value is moved from only if it was queued.
+    [[nodiscard]] bool push(T &&value) noexcept { return emplace(std::move(value)); }
+
+    /// Producer side.
+    bool full() const noexcept { return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_acquire) == N; }
+
+    /// Consumer side. The item is moved out of its slot, so a slot never keeps a shared resource alive and the
+    /// producer overwriting it never releases one.
+    [[nodiscard]] std::optional<T> pop() noexcept {
+        const auto head = m_head.load(std::memory_order_relaxed);
+
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+
+        auto value = std::move(m_items[head & (N - 1)]);
+        m_head.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+    /// Consumer side, gives access to the next item without removing it.
+    [[nodiscard]] T *peek() noexcept {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        return head == m_tail.load(std::memory_order_acquire) ? nullptr : &m_items[head & (N - 1)];
+    }
+
+    static constexpr size_t capacity() noexcept { return N; }
+
+private:
+    template <typename U> bool emplace(U &&value) noexcept {
+        const auto tail = m_tail.load(std::memory_order_relaxed);
+
+        if (tail - m_head.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+
+        m_items[tail & (N - 1)] = std::forward<U>(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::array<T, N> m_items{};
+    alignas(64) std::atomic<size_t> m_head = 0;
+    alignas(64) std::atomic<size_t> m_tail = 0;
+};
+} // namespace audio
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <types.hpp>
+
+#include <span>
+
+namespace audio {
+/// Signal generated while it plays, e.g. a live graph. render() runs on the audio thread and must neither block nor
+/// allocate, the source is created and destroyed on the UI thread.
+struct Source {
+    virtual ~Source() = default;
+
+    /// Fills the output with the next samples of the stream.
+    virtual void render(std::span<types::Float> output) = 0;
+};
+} // namespace audio
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace audio {
+/// Latest-value exchange between one writer thread and one reader thread. The writer fills the back buffer and
+/// publishes it, the reader switches to the newest published buffer whenever it wants. Neither side waits and the
+/// buffers are never copied, a value holding memory is allocated and released by the writer only.
+template <typename T> struct TripleBuffer {
+    /// Writer side, buffer for the next value. It holds an older value, not necessarily the last published one.
+    T &back() noexcept { return m_buffers[m_back]; }
+
+    /// Writer side, makes the back buffer the latest value.
+    void publish() noexcept { m_back = m_middle.exchange(m_back | fresh, std::memory_order_acq_rel) & index; }
+
+    /// Reader side, switches to the latest value if one was published since. Returns true if the value changed.
+    bool acquire() noexcept {
+        if ((m_middle.load(std::memory_order_relaxed) & fresh) == 0) {
+            return false;
+        }
+
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & index;
+        return true;
+    }
+
+    /// Reader side, value acquired last.
+    const T &front() const noexcept { return m_buffers[m_front]; }
+
+private:
+    static constexpr uint8_t index = 0b11;
+    static constexpr uint8_t fresh = 0b100;
+
+    std::array<T, 3> m_buffers{};
+    uint8_t m_front = 0;
+    alignas(64) std::atomic<uint8_t> m_middle = 1;
+    alignas(64) uint8_t m_back = 2;
+};
+} // namespace audio
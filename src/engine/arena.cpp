@@ -0,0 +1,20 @@
+#include "arena.hpp"
+
+#include <algorithm>
+
+namespace engine {
+void BufferArena::assign(size_t buffer_count, size_t buffer_size) {
+    constexpr auto per_line = alignment / sizeof(types::Float);
+
+    m_count = buffer_count;
+    m_size = buffer_size;
+    m_stride = (buffer_size + per_line - 1) / per_line * per_line;
+
+    if (const auto required = m_count * m_stride; required > m_capacity) {
+        m_data.reset(static_cast<types::Float *>(::operator new[](required * sizeof(types::Float), std::align_val_t(alignment))));
+        m_capacity = required;
+    }
+
+    std::fill_n(m_data.get(), m_count * m_stride, 0.f);
+}
+} // namespace engine
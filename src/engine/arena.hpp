@@ -0,0 +1,35 @@
+#pragma once
+
+#include <types.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+
+namespace engine {
+/// Single allocation divided into equally sized sample buffers, every buffer starts at a cache line boundary.
+struct BufferArena {
+    static constexpr size_t alignment = 64;
+
+    /// Reallocates only if the arena is too small, all buffers are zeroed.
+    void assign(size_t buffer_count, size_t buffer_size);
+
+    size_t bufferCount() const { return m_count; }
+    size_t bufferSize() const { return m_size; }
+
+    std::span<types::Float> buffer(size_t index) { return {m_data.get() + index * m_stride, m_size}; }
+    std::span<const types::Float> buffer(size_t index) const { return {m_data.get() + index * m_stride, m_size}; }
+
+private:
+    struct Free {
+        void operator()(types::Float *data) const { ::operator delete[](data, std::align_val_t(alignment)); }
+    };
+
+    std::unique_ptr<types::Float[], Free> m_data;
+    size_t m_capacity = 0;
+    size_t m_count = 0;
+    size_t m_size = 0;
+    size_t m_stride = 0;
+};
+} // namespace engine
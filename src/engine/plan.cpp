@@ -0,0 +1,647 @@
+#include "plan.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <numeric>
+#include <ranges>
+#include <utility>
+#include <unordered_map>
+
+namespace engine {
+std::optional<Plan> Plan::compile(std::span<nodes::Attachment *const> sinks) {
+    enum class Mark { VISITING, DONE };
+
+    struct Frame {
+        nodes::INode *node;
+        nodes::INode::Attachments inputs;
+        size_t next = 0;
+    };
+
+    Plan plan;
+    plan.m_revision = nodes::topologyRevision();
+
+    // signals get their own slot here, schedule() packs them into reusable slots
+    size_t signal_count = 1;
+
+    std::unordered_map<nodes::INode *, Mark> marks;
+    std::unordered_map<nodes::INode *, size_t> output_slots;
+    std::vector<Frame> stack;
+
+    auto slotOf = [&output_slots](const nodes::Attachment *input) -> size_t {
+        if (const auto attached = input->attached()) {
+            return output_slots.at(attached->parent());
+        }
+
+        return silence_slot;
+    };
+
+    // Pushes producer of the input if it was not visited yet, returns false on cycle.
+    auto visit = [&marks, &stack](const nodes::Attachment *input) -> bool {
+        const auto attached = input->attached();
+
+        if (attached == nullptr) {
+            return true;
+        }
+
+        const auto producer = attached->parent();
+
+        if (const auto it = marks.find(producer); it != marks.end()) {
+            return it->second == Mark::DONE;
+        }
+
+        marks.emplace(producer, Mark::VISITING);
+
+        auto inputs = nodes::INode::Attachments{};
+
+        // terminating outputs do not depend on the inputs of their node
+        if (!attached->terminating) {
+            if (const auto forwarded = producer->passthrough()) {
+                inputs.push_back(forwarded);
+            } else {
+                inputs = producer->attachments(nodes::Attachment::Role::INPUT);
+            }
+        }
+
+        stack.push_back({.node = producer, .inputs = std::move(inputs)});
+
+        return true;
+    };
+
+    for (const auto &sink : sinks) {
+        assert(sink->role == nodes::Attachment::Role::INPUT);
+
+        if (!visit(sink)) {
+            return std::nullopt;
+        }
+
+        while (!stack.empty()) {
+            if (auto &top = stack.back(); top.next < top.inputs.size()) {
+                if (!visit(top.inputs[top.next++])) {
+                    return std::nullopt;
+                }
+
+                continue;
+            }
+
+            const auto frame = std::move(stack.back());
+            stack.pop_back();
+
+            marks[frame.node] = Mark::DONE;
+
+            // forwarding nodes alias the slot of their input, consumers share the same read-only buffer
+            if (const auto forwarded = frame.node->passthrough()) {
+                output_slots.emplace(frame.node, slotOf(forwarded));
+                continue;
+            }
+
+            auto kernel = frame.node->createKernel();
+
+            if (kernel == nullptr) {
+                output_slots.emplace(frame.node, silence_slot);
+                continue;
+            }
+
+            const auto inputs_begin = plan.m_input_slots.size();
+
+            for (const auto &input : frame.inputs) {
+                plan.m_input_slots.push_back(slotOf(input));
+            }
+
+            const auto output_slot = signal_count++;
+            output_slots.emplace(frame.node, output_slot);
+
+            plan.m_steps.push_back({
+                .node = frame.node,
+                .kernel = std::move(kernel),
+                .inputs_begin = inputs_begin,
+                .inputs_count = frame.inputs.size(),
+                .output_slot = output_slot,
+            });
+        }
+
+        plan.m_sink_slots.push_back(slotOf(sink));
+    }
+
+    plan.schedule(signal_count);
+
+    return plan;
+}
+
+std::optional<Plan> Plan::compile(nodes::Attachment &sink) {
+    const std::array sinks{&sink};
+    return compile(sinks);
+}
+
+void Plan::schedule(size_t signal_count) {
+    std::vector<size_t> producers(signal_count, SIZE_MAX);
+    std::vector<size_t> levels(m_steps.size(), 0);
+
+    auto inputsOf = [this](const Step &step) { return std::span(m_input_slots).subspan(step.inputs_begin, step.inputs_count); };
+
+    for (size_t i = 0; i < m_steps.size(); ++i) {
+        for (const auto signal : inputsOf(m_steps[i])) {
+            if (const auto producer = producers[signal]; producer != SIZE_MAX) {
+                levels[i] = std::max(levels[i], levels[producer] + 1);
+            }
+        }
+
+        producers[m_steps[i].output_slot] = i;
+    }
+
+    // level order is topological as well, steps of the same level never depend on each other
+    std::vector<size_t> order(m_steps.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, {}, [&levels](size_t i) { return levels[i]; });
+
+    std::vector<Step> sorted;
+    sorted.reserve(m_steps.size());
+
+    for (const auto i : order) {
+        sorted.push_back(std::move(m_steps[i]));
+    }
+
+    m_steps = std::move(sorted);
+    std::ranges::sort(levels);
+
+    std::vector<std::vector<size_t>> readers(signal_count);
+    std::vector<size_t> last_levels(signal_count, 0);
+
+    for (size_t i = 0; i < m_steps.size(); ++i) {
+        producers[m_steps[i].output_slot] = i;
+        last_levels[m_steps[i].output_slot] = levels[i];
+
+        for (const auto signal : inputsOf(m_steps[i])) {
+            if (std::ranges::find(readers[signal], i) == readers[signal].end()) {
+                readers[signal].push_back(i);
+                last_levels[signal] = levels[i];
+            }
+        }
+    }
+
+    for (const auto signal : m_sink_slots) {
+        last_levels[signal] = SIZE_MAX;
+    }
+
+    std::vector<std::vector<size_t>> data_dependents(m_steps.size());
+    std::vector<std::vector<size_t>> anti_dependents(m_steps.size());
+    std::vector<size_t> slots(signal_count, silence_slot);
+    std::vector<size_t> occupants(1, silence_slot);
+    std::vector<size_t> free_slots;
+    std::vector<std::vector<size_t>> expiring(m_steps.empty() ? 0 : levels.back() + 1);
+
+    for (size_t signal = 0; signal < signal_count; ++signal) {
+        if (last_levels[signal] < expiring.size() && producers[signal] != SIZE_MAX) {
+            expiring[last_levels[signal]].push_back(signal);
+        }
+    }
+
+    for (size_t i = 0; i < m_steps.size(); ++i) {
+        // slots read by earlier levels only are free, reading steps of the same level may still be running
+        if (i == 0 || levels[i] != levels[i - 1]) {
+            for (size_t level = i == 0 ? 0 : levels[i - 1]; level < levels[i]; ++level) {
+                for (const auto signal : expiring[level]) {
+                    free_slots.push_back(slots[signal]);
+                }
+            }
+        }
+
+        for (const auto signal : inputsOf(m_steps[i])) {
+            if (const auto producer = producers[signal]; producer != SIZE_MAX) {
+                if (std::ranges::find(data_dependents[producer], i) == data_dependents[producer].end()) {
+                    data_dependents[producer].push_back(i);
+                }
+            }
+        }
+
+        const auto signal = m_steps[i].output_slot;
+
+        if (free_slots.empty()) {
+            slots[signal] = occupants.size();
+            occupants.push_back(signal);
+            continue;
+        }
+
+        slots[signal] = free_slots.back();
+        free_slots.pop_back();
+
+        const auto previous = std::exchange(occupants[slots[signal]], signal);
+        const auto &waiting = readers[previous].empty() ? std::vector{producers[previous]} : readers[previous];
+
+        for (const auto reader : waiting) {
+            if (std::ranges::find(data_dependents[reader], i) == data_dependents[reader].end()) {
+                anti_dependents[reader].push_back(i);
+            }
+        }
+    }
+
+    for (auto &slot : m_input_slots) {
+        slot = slots[slot];
+    }
+
+    for (auto &slot : m_sink_slots) {
+        slot = slots[slot];
+    }
+
+    std::vector<size_t> level_widths(m_steps.size(), 0);
+
+    for (size_t i = 0; i < m_steps.size(); ++i) {
+        auto &step = m_steps[i];
+        // packed slots are shared, only the signal tells whether a sink reads the step
+        step.read_by_sink = last_levels[step.output_slot] == SIZE_MAX;
+        step.output_slot = slots[step.output_slot];
+        step.dependents_begin = m_dependents.size();
+        step.dependents_count = data_dependents[i].size();
+        step.successors_count = data_dependents[i].size() + anti_dependents[i].size();
+
+        m_dependents.insert(m_dependents.end(), data_dependents[i].begin(), data_dependents[i].end());
+        m_dependents.insert(m_dependents.end(), anti_dependents[i].begin(), anti_dependents[i].end());
+
+        for (const auto successor : std::span(m_dependents).last(step.successors_count)) {
+            m_steps[successor].dependency_count += 1;
+        }
+
+        m_width = std::max(m_width, ++level_widths[levels[i]]);
+    }
+
+    for (size_t i = 0; i < m_steps.size(); ++i) {
+        auto &step = m_steps[i];
+        const auto read_by_kernel = std::ranges::any_of(data_dependents[i], [this](size_t j) { return !m_steps[j].kernel->readsControl(); });
+
+        step.interpolate = step.read_by_sink || read_by_kernel;
+    }
+
+    m_slot_count = occupants.size();
+}
+
+void Plan::setCaching(bool enabled) {
+    m_caching = enabled;
+
+    if (!enabled) {
+        for (auto &step : m_steps) {
+            step.cache = {};
+            step.rendered_revision = SIZE_MAX;
+        }
+    }
+}
+
+void Plan::prepare(const nodes::RenderInfo &info) {
+    assert(info.block_size > 0);
+
+    m_info = info;
+
+    for (auto &step : m_steps) {
+        step.rendered_revision = SIZE_MAX;
+    }
+
+    m_slots.assign(m_slot_count, info.block_size);
+    m_slot_signals.assign(m_slot_count, nodes::Signal::silence());
+    m_input_signals.assign(m_input_slots.size(), nodes::Signal::silence());
+
+    if (const auto period = info.control_period; period > 0) {
+        m_controls.assign(m_slot_count, (info.block_size + period - 1) / period + 2);
+    } else {
+        m_controls.assign(m_slot_count, 0);
+    }
+    m_input_controls.clear();
+
+    for (const auto &slot : m_input_slots) {
+        m_input_controls.push_back(m_controls.buffer(slot));
+    }
+
+    // full blocks never reallocate views, so processing them does not allocate
+    m_input_views.reserve(m_input_slots.size());
+    m_views_length = 0;
+
+    for (auto &step : m_steps) {
+        step.kernel->prepare(info);
+    }
+
+    update();
+    reset();
+}
+
+void Plan::reset(size_t position) {
+    m_position = position;
+
+    for (auto &step : m_steps) {
+        step.kernel->reset();
+    }
+}
+
+void Plan::update() {
+    for (auto &step : m_steps) {
+        step.kernel->update();
+    }
+}
+
+std::vector<const nodes::INode *> Plan::nodes() const {
+    std::vector<const nodes::INode *> list;
+    list.reserve(m_steps.size());
+
+    for (const auto &step : m_steps) {
+        list.push_back(step.node);
+    }
+
+    return list;
+}
+
+// Only outputs replayed by later runs are kept: the ones read by sinks and the clean producers at the edge of a change,
+// which the next change of the same nodes reads again. Memory then depends on the number of sinks and the width of the
+// edited region rather than on the depth of the graph.
+void Plan::planCachedRun(size_t length) {
+    auto edited = false;
+
+    for (auto &step : m_steps) {
+        // the revision is taken now, the node may change while the run is processed on another thread
+        step.render_revision = step.node->revision();
+        step.dirty = step.rendered_revision != step.render_revision;
+        edited |= step.dirty;
+    }
+
+    // steps are sorted, so a change reaches all consumers in a single pass
+    for (const auto &step : m_steps) {
+        if (step.dirty) {
+            for (size_t i = 0; i < step.dependents_count; ++i) {
+                m_steps[m_dependents[step.dependents_begin + i]].dirty = true;
+            }
+        }
+    }
+
+    // consumers come first in reverse order, so every step knows which of its readers are processed
+    for (auto &step : std::views::reverse(m_steps)) {
+        const auto dependents = std::span(m_dependents).subspan(step.dependents_begin, step.dependents_count);
+        const auto edge = step.read_by_sink || std::ranges::any_of(dependents, [this](size_t i) { return m_steps[i].dirty; });
+        const auto read = edge || std::ranges::any_of(dependents, [this](size_t i) { return m_steps[i].action == Action::PROCESS; });
+
+        if (step.dirty) {
+            step.action = Action::PROCESS;
+            step.cache.resize(step.read_by_sink ? length : 0);
+        } else if (!read) {
+            step.action = Action::SKIP;
+
+            // a change moves the edge, caches of an earlier one are dropped
+            if (edited) {
+                step.cache = {};
+            }
+        } else if (step.cache.size() >= length) {
+            step.action = Action::LOAD;
+        } else {
+            step.action = Action::PROCESS;
+            step.cache.resize(edge ? length : 0);
+        }
+
+        if (step.cache.empty()) {
+            step.cache.shrink_to_fit();
+        }
+    }
+}
+
+size_t Plan::cacheSize() const {
+    size_t size = 0;
+
+    for (const auto &step : m_steps) {
+        size += step.cache.size();
+    }
+
+    return size;
+}
+
+void Plan::processStep(size_t index) {
+    auto &step = m_steps[index];
+    const auto output = m_slots.buffer(step.output_slot).first(m_views_length);
+
+    switch (step.action) {
+    case Action::PROCESS: {
+        const auto signals = std::span(m_input_signals).subspan(step.inputs_begin, step.inputs_count);
+
+        for (size_t i = 0; i < signals.size(); ++i) {
+            signals[i] = m_slot_signals[m_input_slots[step.inputs_begin + i]];
+        }
+
+        const auto inputs = nodes::Kernel::Inputs{
+            .blocks = std::span(m_input_views).subspan(step.inputs_begin, step.inputs_count),
+            .signals = signals,
+            .controls = std::span(m_input_controls).subspan(step.inputs_begin, step.inputs_count),
+            .position = m_position,
+            .control_period = m_info->control_period,
+        };
+
+        if (!processControl(step, inputs, output)) {
+            storeSignal(step.output_slot, step.kernel->processBlock(inputs, output));
+        }
+
+        if (m_position + output.size() <= step.cache.size()) {
+            std::ranges::copy(output, step.cache.begin() + m_position);
+        }
+    } break;
+    case Action::LOAD:
+        std::ranges::copy_n(step.cache.begin() + m_position, output.size(), output.begin());
+        m_slot_signals[step.output_slot] = nodes::Signal::dense();
+        break;
+    case Action::SKIP:
+        break;
+    }
+}
+
+bool Plan::processControl(Step &step, const nodes::Kernel::Inputs &inputs, std::span<types::Float> output) {
+    const auto period = m_info->control_period;
+
+    if (period == 0) {
+        return false;
+    }
+
+    const auto points = m_controls.buffer(step.output_slot).first(nodes::controlPointCount(m_position, output.size(), period));
+
+    if (!step.kernel->processControl(inputs, points)) {
+        return false;
+    }
+
+    // cached outputs are stored as samples
+    if (step.interpolate || !step.cache.empty()) {
+        nodes::interpolateControl(points, m_position, period, output);
+    }
+
+    m_slot_signals[step.output_slot] = nodes::Signal::control();
+    return true;
+}
+
+void Plan::storeSignal(size_t slot, nodes::Signal signal) {
+    // the whole buffer is filled, so a later and longer block finds the constant as well
+    if (signal.isConstant() && m_slot_signals[slot] != signal) {
+        std::ranges::fill(m_slots.buffer(slot), signal.value);
+    }
+
+    m_slot_signals[slot] = signal;
+}
+
+void Plan::processParallel(ThreadPool &pool) {
+    if (m_parallel == nullptr || m_parallel->pool != &pool) {
+        m_parallel = std::make_unique<Parallel>();
+        m_parallel->pool = &pool;
+        m_parallel->remaining = std::make_unique<std::atomic<size_t>[]>(m_steps.size());
+    }
+
+    m_parallel->pending.store(m_steps.size(), std::memory_order_relaxed);
+
+    for (size_t i = 0; i < m_steps.size(); ++i) {
+        m_parallel->remaining[i].store(m_steps[i].dependency_count, std::memory_order_relaxed);
+    }
+
+    for (size_t i = 0; i < m_steps.size(); ++i) {
+        if (m_steps[i].dependency_count == 0) {
+            pool.push({.fn = parallelTask, .data = this, .index = i});
+        }
+    }
+
+    pool.wait(m_parallel->pending);
+}
+
+void Plan::parallelTask(void *data, size_t index) {
+    auto &plan = *static_cast<Plan *>(data);
+    auto &parallel = *plan.m_parallel;
+    const auto &step = plan.m_steps[index];
+
+    plan.processStep(index);
+
+    for (size_t i = 0; i < step.successors_count; ++i) {
+        const auto dependent = plan.m_dependents[step.dependents_begin + i];
+
+        if (parallel.remaining[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            parallel.pool->push({.fn = parallelTask, .data = &plan, .index = dependent});
+        }
+    }
+
+    parallel.pending.fetch_sub(1, std::memory_order_release);
+}
+
+void Plan::process(std::span<const std::span<types::Float>> outputs, ThreadPool *pool) {
+    assert(m_info.has_value());
+    assert(outputs.size() == m_sink_slots.size());
+
+    const auto length = outputs.empty() ? 0 : outputs.front().size();
+    const auto parallel = pool != nullptr && pool->workerCount() > 0 && m_width > 1;
+
+    for (size_t offset = 0; offset < length; offset += m_info->block_size) {
+        const auto block = std::min(m_info->block_size, length - offset);
+
+        // views are rebuilt only when the block size changes, e.g. for the last, shorter block
+        if (m_views_length != block) {
+            m_input_views.clear();
+
+            for (const auto &slot : m_input_slots) {
+                m_input_views.emplace_back(m_slots.buffer(slot).first(block));
+            }
+
+            m_views_length = block;
+        }
+
+        if (parallel) {
+            processParallel(*pool);
+        } else {
+            for (size_t i = 0; i < m_steps.size(); ++i) {
+                processStep(i);
+            }
+        }
+
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            assert(outputs[i].size() == length);
+            std::ranges::copy_n(m_slots.buffer(m_sink_slots[i]).begin(), block, outputs[i].begin() + offset);
+        }
+
+        m_position += block;
+    }
+}
+
+void Plan::run(const nodes::RenderInfo &info, std::span<const std::span<types::Float>> outputs, ThreadPool *pool) {
+    begin(info, outputs.empty() ? 0 : outputs.front().size());
+    process(outputs, pool);
+    finish();
+}
+
+void Plan::begin(const nodes::RenderInfo &info, size_t length) {
+    if (m_info != info) {
+        prepare(info);
+    } else {
+        update();
+        reset();
+    }
+
+    if (m_caching) {
+        planCachedRun(length);
+    }
+}
+
+void Plan::abort() {
+    for (auto &step : m_steps) {
+        if (step.action == Action::PROCESS) {
+            step.rendered_revision = SIZE_MAX;
+        }
+
+        step.action = Action::PROCESS;
+    }
+}
+
+void Plan::finish() {
+    if (!m_caching) {
+        return;
+    }
+
+    for (auto &step : m_steps) {
+        if (step.action == Action::PROCESS) {
+            step.rendered_revision = step.render_revision;
+        }
+
+        step.action = Action::PROCESS;
+    }
+}
+
+void Plan::run(const nodes::RenderInfo &info, std::span<types::Float> output, ThreadPool *pool) {
+    const std::array outputs{output};
+    run(info, outputs, pool);
+}
+
+bool InputRenderer::render(const nodes::RenderInfo &info, std::span<types::Float> output, ThreadPool *pool) {
+    const auto valid = begin(info, output.size());
+    process(output, pool);
+    finish();
+    return valid;
+}
+
+bool InputRenderer::begin(const nodes::RenderInfo &info, size_t length) {
+    if (m_revision != nodes::topologyRevision()) {
+        m_plan = Plan::compile(m_sink);
+        m_revision = nodes::topologyRevision();
+    }
+
+    if (!m_plan) {
+        return false;
+    }
+
+    m_plan->setCaching(m_caching);
+    m_plan->begin(info, length);
+    return true;
+}
+
+void InputRenderer::process(std::span<types::Float> output, ThreadPool *pool) {
+    if (!m_plan) {
+        std::ranges::fill(output, 0.f);
+        return;
+    }
+
+    const std::array outputs{output};
+    m_plan->process(outputs, pool);
+}
+
+void InputRenderer::finish() {
+    if (m_plan) {
+        m_plan->finish();
+    }
+}
+
+void InputRenderer::abort() {
+    if (m_plan) {
+        m_plan->abort();
+    }
+}
+} // namespace engine
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "arena.hpp"
+#include "thread_pool.hpp"
+
+#include <nodes/nodes.hpp>
+#include <types.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace engine {
+/// Flat, topologically sorted schedule of node kernels feeding a set of sink (INPUT) attachments.
+/// Every node is processed exactly once per run, inputs are resolved to buffer slots at compile time.
+/// Slots are reused once all readers of their previous signal are done, like registers.
+struct Plan {
+    /// Returns std::nullopt if the graph feeding the sinks contains a cycle.
+    static std::optional<Plan> compile(std::span<nodes::Attachment *const> sinks);
+    static std::optional<Plan> compile(nodes::Attachment &sink);
+
+    bool isStale() const { return m_revision != nodes::topologyRevision(); }
+
+    size_t stepCount() const { return m_steps.size(); }
+    /// Nodes of the steps in processing order.
+    std::vector<const nodes::INode *> nodes() const;
+    size_t sinkCount() const { return m_sink_slots.size(); }
+    /// Number of block buffers, including the silence slot.
+    size_t slotCount() const { return m_slot_count; }
+
+    /// Largest number of steps that do not depend on each other, plans narrower than 2 always run serially.
+    size_t width() const { return m_width; }
+
+    /// Makes run() re-process only nodes changed since the last run and their consumers, unchanged producers are
+    /// replayed from their cached output or skipped altogether. Each cache holds the full length of a run, one is kept
+    /// for every output read by a sink and for every clean producer feeding a changed node. The first change of a node
+    /// renders its producers again, the following ones replay them.
+    void setCaching(bool enabled);
+    /// Samples held by caches.
+    size_t cacheSize() const;
+
+    /// Prepares kernels for the render info, updates them and restores their initial state.
+    void prepare(const nodes::RenderInfo &);
+    /// Restores the initial state of kernels, the stream continues at the position.
+    void reset(size_t position = 0);
+    /// Publishes node parameters to kernels, must be called on the thread owning the nodes. It may overlap with
+    /// processing on another thread, kernels pick the parameters up at their next block.
+    void update();
+
+    /// Renders the next samples of every sink into the output with the same index, all outputs must have the same
+    /// size. Outputs are processed in blocks, consecutive calls continue the stream.
+    /// With a thread pool independent steps of a block run concurrently, the result is identical to a serial run.
+    void process(std::span<const std::span<types::Float>> outputs, ThreadPool * = nullptr);
+
+    /// Renders sinks from the beginning of the stream. A cached run cannot be continued with process().
+    void run(const nodes::RenderInfo &, std::span<const std::span<types::Float>> outputs, ThreadPool * = nullptr);
+    void run(const nodes::RenderInfo &, std::span<types::Float> output, ThreadPool * = nullptr);
+
+    /// run() in parts: begin() and finish() on the thread owning the nodes, process() for consecutive parts of the
+    /// outputs in between, possibly on another thread. Nodes may change meanwhile, the run renders their state at
+    /// begin(). Nothing else may use the plan until finish().
+    void begin(const nodes::RenderInfo &, size_t length);
+    void finish();
+    /// Ends a run that did not process the whole length, caches it touched are discarded.
+    void abort();
+
+private:
+    enum class Action { PROCESS, LOAD, SKIP };
+
+    struct Step {
+        nodes::INode *node;
+        std::unique_ptr<nodes::Kernel> kernel;
+        size_t inputs_begin;
+        size_t inputs_count;
+        size_t output_slot;
+
+        // steps reading the output of this one, followed by steps that have to wait before reusing its slots
+        size_t dependents_begin = 0;
+        size_t dependents_count = 0;
+        size_t successors_count = 0;
+        size_t dependency_count = 0;
+
+        bool read_by_sink = false;
+        // control points are interpolated only if something reads the samples
+        bool interpolate = true;
+
+        Action action = Action::PROCESS;
+        // changed since the last run, or fed by a changed step
+        bool dirty = true;
+        std::vector<types::Float> cache{};
+        size_t rendered_revision = SIZE_MAX;
+        size_t render_revision = SIZE_MAX;
+    };
+
+    // kept behind a pointer, atomics would make the plan immovable
+    struct Parallel {
+        ThreadPool *pool;
+        std::unique_ptr<std::atomic<size_t>[]> remaining;
+        std::atomic<size_t> pending;
+    };
+
+    void schedule(size_t signal_count);
+    void planCachedRun(size_t length);
+    void processStep(size_t index);
+    bool processControl(Step &, const nodes::Kernel::Inputs &, std::span<types::Float> output);
+    void storeSignal(size_t slot, nodes::Signal);
+    void processParallel(ThreadPool &);
+    static void parallelTask(void *plan, size_t index);
+
+    // slot 0 is always silence and is used by detached inputs
+    static constexpr size_t silence_slot = 0;
+
+    std::vector<Step> m_steps;
+    std::vector<size_t> m_input_slots;
+    std::vector<size_t> m_sink_slots;
+    std::vector<size_t> m_dependents;
+    size_t m_width = 0;
+    std::unique_ptr<Parallel> m_parallel;
+
+    size_t m_slot_count = 1;
+    BufferArena m_slots;
+    std::vector<std::span<const types::Float>> m_input_views;
+    std::vector<nodes::Signal> m_input_signals;
+    std::vector<std::span<const types::Float>> m_input_controls;
+    BufferArena m_controls;
+    // what each slot holds, lets constant producers skip filling a slot that already has their value
+    std::vector<nodes::Signal> m_slot_signals;
+    size_t m_views_length = 0;
+    size_t m_position = 0;
+    bool m_caching = false;
+
+    std::optional<nodes::RenderInfo> m_info;
+    size_t m_revision = SIZE_MAX;
+};
+
+/// Renders the signal arriving at a single INPUT attachment, recompiling its plan when the topology changes.
+struct InputRenderer {
+    InputRenderer(nodes::Attachment &sink, bool caching = false) : m_sink(sink), m_caching(caching) {}
+
+    /// Returns false if the graph contains a cycle, output is then filled with silence.
+    bool render(const nodes::RenderInfo &, std::span<types::Float> output, ThreadPool * = nullptr);
+
+    /// render() in parts, see Plan::begin().
+    bool begin(const nodes::RenderInfo &, size_t length);
+    void process(std::span<types::Float> output, ThreadPool * = nullptr);
+    void finish();
+    void abort();
+
+private:
+    nodes::Attachment &m_sink;
+    bool m_caching;
+    std::optional<Plan> m_plan;
+    size_t m_revision = SIZE_MAX;
+};
+} // namespace engine
@@ -0,0 +1,93 @@
+#include "render_job.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace engine {
+void RenderJob::start(InputRenderer &renderer, const nodes::RenderInfo &info, size_t length, ThreadPool *pool, size_t upsampling) {
+    assert(upsampling > 0);
+
+    cancel();
+
+    auto writer = audio::ClipWriter(length);
+
+    m_renderer = &renderer;
+    m_clip = writer.clip();
+    m_cancel.store(false, std::memory_order_relaxed);
+    m_done.store(false, std::memory_order_relaxed);
+
+    // interpolation needs the rendered sample following the last one of the clip
+    renderer.begin(info, upsampling == 1 ? length : (length + upsampling - 1) / upsampling + 1);
+
+    m_thread = std::thread([this, writer = std::move(writer), pool, upsampling]() mutable {
+        const auto t1 = std::chrono::steady_clock::now();
+
+        render(writer, pool, upsampling);
+
+        const auto t2 = std::chrono::steady_clock::now();
+
+        m_duration = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1);
+        m_done.store(true, std::memory_order_release);
+    });
+}
+
+void RenderJob::render(audio::ClipWriter &writer, ThreadPool *pool, size_t upsampling) {
+    if (upsampling == 1) {
+        while (!writer.pending().empty() && !m_cancel.load(std::memory_order_relaxed)) {
+            const auto part = writer.pending().first(std::min(writer.pending().size(), part_size));
+            m_renderer->process(part, pool);
+            writer.commit(part.size());
+        }
+
+        return;
+    }
+
+    std::vector<types::Float> rendered(part_size / upsampling + 1);
+    types::Float last = 0;
+
+    m_renderer->process(std::span(&last, 1), pool);
+
+    while (!writer.pending().empty() && !m_cancel.load(std::memory_order_relaxed)) {
+        const auto in = std::span(rendered).first(std::min(rendered.size(), (writer.pending().size() + upsampling - 1) / upsampling));
+        m_renderer->process(in, pool);
+
+        const auto out = writer.pending().first(std::min(writer.pending().size(), in.size() * upsampling));
+
+        for (size_t i = 0; i < out.size(); ++i) {
+            const auto prev = i < upsampling ? last : in[i / upsampling - 1];
+            const auto next = in[i / upsampling];
+            out[i] = prev + (next - prev) * static_cast<types::Float>(i % upsampling) / static_cast<types::Float>(upsampling);
+        }
+
+        last = in.back();
+        writer.commit(out.size());
+    }
+}
+
+void RenderJob::cancel() {
+    if (isRunning()) {
+        m_cancel.store(true, std::memory_order_relaxed);
+        join();
+    }
+}
+
+bool RenderJob::poll() {
+    if (!isRunning() || !m_done.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    join();
+    return m_clip.isComplete();
+}
+
+void RenderJob::join() {
+    m_thread.join();
+
+    if (m_clip.isComplete()) {
+        m_renderer->finish();
+    } else {
+        m_renderer->abort();
+    }
+}
+} // namespace engine
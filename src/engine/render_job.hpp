@@ -0,0 +1,60 @@
+#pragma once
+
+#include "plan.hpp"
+#include "thread_pool.hpp"
+
+#include <audio/clip.hpp>
+#include <nodes/nodes.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+
+namespace engine {
+/// Renders the sink of an InputRenderer into a growing clip on a background thread, so the UI keeps running.
+/// All methods are called on the UI thread, the renderer must not be used elsewhere while the job runs.
+struct RenderJob {
+    RenderJob() = default;
+    RenderJob(const RenderJob &) = delete;
+    RenderJob &operator=(const RenderJob &) = delete;
+    ~RenderJob() { cancel(); }
+
+    /// Starts rendering length samples, a running job is cancelled first. Nodes may change while the job runs,
+    /// it renders them as they were at the start.
+    /// With upsampling the graph is rendered at the rate of the render info, which is that many times lower than
+    /// the rate of the clip, and the clip is interpolated linearly. Meant for quick drafts.
+    void start(InputRenderer &, const nodes::RenderInfo &, size_t length, ThreadPool * = nullptr, size_t upsampling = 1);
+
+    /// Stops a running job, its clip stays incomplete.
+    void cancel();
+
+    /// Completes a job which is done, returns true once when its clip is complete. Meant to be called every frame.
+    bool poll();
+
+    bool isRunning() const { return m_thread.joinable(); }
+
+    /// Rendered fraction of the clip.
+    float progress() const { return m_clip.empty() ? 1.f : static_cast<float>(m_clip.samples().size()) / static_cast<float>(m_clip.size()); }
+
+    /// Clip of the last started job, it grows while the job runs.
+    const audio::Clip &clip() const { return m_clip; }
+
+    /// Render time of the last completed job.
+    std::chrono::microseconds duration() const { return m_duration; }
+
+private:
+    void render(audio::ClipWriter &, ThreadPool *, size_t upsampling);
+    void join();
+
+    // the clip is committed in parts, which also bounds how long cancellation takes
+    static constexpr size_t part_size = 2048;
+
+    InputRenderer *m_renderer = nullptr;
+    audio::Clip m_clip;
+    std::thread m_thread;
+    std::atomic<bool> m_cancel = false;
+    std::atomic<bool> m_done = false;
+    std::chrono::microseconds m_duration{};
+};
+} // namespace engine
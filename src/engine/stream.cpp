@@ -0,0 +1,63 @@
+#include "stream.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace engine {
+std::unique_ptr<Stream> Stream::create(nodes::Attachment &sink, const nodes::RenderInfo &info, size_t position) {
+    auto plan = Plan::compile(sink);
+
+    if (!plan) {
+        return nullptr;
+    }
+
+    return std::unique_ptr<Stream>(new Stream(std::move(*plan), info, position));
+}
+
+Stream::Stream(Plan plan, const nodes::RenderInfo &info, size_t position)
+    : m_plan(std::move(plan)), m_block(info.block_size), m_offset(info.block_size), m_nodes(m_plan.nodes()),
+      m_topology_revision(nodes::topologyRevision()) {
+    m_plan.prepare(info);
+    m_plan.reset(position);
+
+    for (const auto node : m_nodes) {
+        m_revisions.push_back(node->revision());
+    }
+}
+
+void Stream::update() {
+    // a removed node changes the topology, so nodes are dereferenced only while they are alive
+    if (isOutdated()) {
+        return;
+    }
+
+    auto changed = false;
+
+    for (size_t i = 0; i < m_nodes.size(); ++i) {
+        const auto revision = m_nodes[i]->revision();
+        changed |= m_revisions[i] != revision;
+        m_revisions[i] = revision;
+    }
+
+    if (changed) {
+        m_plan.update();
+    }
+}
+
+void Stream::render(std::span<types::Float> output) {
+    while (!output.empty()) {
+        // always whole blocks, so processing reuses the views built by prepare
+        if (m_offset == m_block.size()) {
+            const std::array outputs{std::span(m_block)};
+            m_plan.process(outputs);
+            m_offset = 0;
+        }
+
+        const auto count = std::min(output.size(), m_block.size() - m_offset);
+        std::ranges::copy_n(m_block.begin() + m_offset, count, output.begin());
+
+        m_offset += count;
+        output = output.subspan(count);
+    }
+}
+} // namespace engine
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "plan.hpp"
+
+#include <audio/source.hpp>
+#include <nodes/nodes.hpp>
+#include <types.hpp>
+
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace engine {
+/// Live rendering of a single INPUT attachment for the audio thread. The plan is compiled and its kernels updated on
+/// the UI thread, render() then pulls fixed blocks without touching the nodes. Parameter edits are published to the
+/// running kernels, a changed topology needs a new stream.
+struct Stream : audio::Source {
+    /// Returns nullptr if the graph feeding the sink contains a cycle. The stream starts at the position.
+    static std::unique_ptr<Stream> create(nodes::Attachment &sink, const nodes::RenderInfo &, size_t position = 0);
+
+    /// True once the topology changed. Safe to call on the UI thread while the stream renders on the audio thread.
+    bool isOutdated() const { return m_topology_revision != nodes::topologyRevision(); }
+
+    /// Publishes parameters if a node feeding the sink changed, they are applied at the next block. Safe to call on
+    /// the UI thread while the stream renders, as long as the stream is not outdated.
+    void update();
+
+    void render(std::span<types::Float> output) override;
+
+private:
+    Stream(Plan, const nodes::RenderInfo &, size_t position);
+
+    Plan m_plan;
+    std::vector<types::Float> m_block;
+    size_t m_offset;
+
+    // owned by the UI thread
+    std::vector<const nodes::INode *> m_nodes;
+    std::vector<size_t> m_revisions;
+    size_t m_topology_revision;
+};
+} // namespace engine
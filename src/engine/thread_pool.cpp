@@ -0,0 +1,135 @@
+#include "thread_pool.hpp"
+
+#include <optional>
+
+namespace engine {
+namespace {
+thread_local const ThreadPool *tl_pool = nullptr;
+thread_local size_t tl_queue = 0;
+
+constexpr size_t spin_count = 64;
+} // namespace
+
+ThreadPool::ThreadPool(size_t worker_count) {
+    for (size_t i = 0; i < worker_count + 1; ++i) {
+        m_queues.push_back(std::make_unique<Queue>());
+    }
+
+    for (size_t i = 0; i < worker_count; ++i) {
+        m_threads.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lck(m_sleep_mtx);
+        m_stop = true;
+    }
+
+    m_sleep_cv.notify_all();
+
+    for (auto &thread : m_threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::push(Task task) {
+    const auto queue_index = [this] {
+        if (tl_pool == this) {
+            return tl_queue;
+        }
+
+        return m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+    }();
+
+    {
+        auto &queue = *m_queues[queue_index];
+        std::lock_guard lck(queue.mtx);
+        queue.tasks.push_back(task);
+    }
+
+    m_queued.fetch_add(1);
+
+    if (m_sleeping.load() > 0) {
+        { std::lock_guard lck(m_sleep_mtx); }
+        m_sleep_cv.notify_one();
+    }
+}
+
+void ThreadPool::wait(const std::atomic<size_t> &counter) {
+    // the waiting thread steals like a worker without a queue of its own
+    const auto self = tl_pool == this ? tl_queue : m_queues.size() - 1;
+
+    while (counter.load(std::memory_order_acquire) > 0) {
+        if (!tryRun(self)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool ThreadPool::tryRun(size_t self) {
+    auto take = [this](size_t index, bool own) -> std::optional<Task> {
+        auto &queue = *m_queues[index];
+        std::lock_guard lck(queue.mtx);
+
+        if (queue.tasks.empty()) {
+            return std::nullopt;
+        }
+
+        Task task;
+
+        if (own) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        } else {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+
+        return task;
+    };
+
+    if (m_queued.load() == 0) {
+        return false;
+    }
+
+    auto task = take(self, true);
+
+    for (size_t i = 1; !task && i < m_queues.size(); ++i) {
+        task = take((self + i) % m_queues.size(), false);
+    }
+
+    if (!task) {
+        return false;
+    }
+
+    m_queued.fetch_sub(1);
+    task->fn(task->data, task->index);
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    tl_pool = this;
+    tl_queue = index;
+
+    while (true) {
+        for (size_t spin = 0; spin < spin_count; ++spin) {
+            if (tryRun(index)) {
+                spin = 0;
+                continue;
+            }
+
+            std::this_thread::yield();
+        }
+
+        std::unique_lock lck(m_sleep_mtx);
+        m_sleeping.fetch_add(1);
+        m_sleep_cv.wait(lck, [this] { return m_stop || m_queued.load() > 0; });
+        m_sleeping.fetch_sub(1);
+
+        if (m_stop) {
+            return;
+        }
+    }
+}
+} // namespace engine
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace engine {
+/// Work-stealing pool. Every worker owns a deque, runs its own tasks newest first and steals the oldest tasks of
+/// other workers when it runs out of work. Tasks are plain function pointers, pushing one never allocates a closure.
+struct ThreadPool {
+    struct Task {
+        void (*fn)(void *data, size_t index);
+        void *data;
+        size_t index;
+    };
+
+    /// The thread waiting for results helps with the work, so one core is left for it by default.
+    explicit ThreadPool(size_t worker_count = std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    ThreadPool &operator=(ThreadPool &&) = delete;
+
+    size_t workerCount() const { return m_threads.size(); }
+
+    /// Queues on the deque of the calling worker, tasks from other threads are spread over all deques.
+    void push(Task);
+
+    /// Runs queued tasks on the calling thread until the counter drops to zero.
+    void wait(const std::atomic<size_t> &counter);
+
+private:
+    struct Queue {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    bool tryRun(size_t self);
+    void workerLoop(size_t index);
+
+    // one queue per worker and one shared by all other threads
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::atomic<size_t> m_queued = 0;
+    std::atomic<size_t> m_sleeping = 0;
+    std::atomic<size_t> m_next_queue = 0;
+
+    std::mutex m_sleep_mtx;
+    std::condition_variable m_sleep_cv;
+    bool m_stop = false;
+};
+} // namespace engine
@@ -0,0 +1,5 @@
+#include "arena.cpp"
+#include "plan.cpp"
+#include "render_job.cpp"
+#include "stream.cpp"
+#include "thread_pool.cpp"
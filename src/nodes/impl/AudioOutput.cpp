@@ -4,30 +4,86 @@
 #include <nodes/type_info.hpp>
 
 #include <Ctx.hpp>
+#include <engine/plan.hpp>
+#include <engine/render_job.hpp>
+#include <engine/stream.hpp>
 #include <nuklear.h>
 #include <ui/ui.hpp>
 
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
 #include <chrono>
 
 namespace {
 struct AudioOutput : public nodes::INode {
     AudioOutput() : INode(TYPE_INFO_STR(AudioOutput), 280, 250) {}
 
-    void process(Ctx &ctx, std::span<types::Float> buf) override {
-        if (const auto attached = input.attached()) {
-            attached->parent()->process(ctx, buf);
+    // the voice would keep playing, or go to the next node allocated at this address
+    ~AudioOutput() override {
+        if (audio_system) {
+            audio_system->release(this);
         }
     }
 
+    std::unique_ptr<nodes::Kernel> createKernel() override { return nullptr; }
+
     void ui(Ctx &ctx) override {
-        if (ctx.audio.currentParrent() == nullptr) {
-            ctx.audio.setClip({}, this);
+        audio_system = &ctx.audio;
+
+        // the full quality render follows a finished draft
+        if (draft_job.poll()) {
+            startFullRender(ctx);
+        }
+
+        // a playing draft is replaced by the full quality clip at the same position
+        if (render_job.poll()) {
+            us_processing = render_job.duration().count();
+
+            if (clip != render_job.clip()) {
+                if (ctx.audio.currentClip(this) == clip) {
+                    ctx.audio.setClip(render_job.clip(), this);
+                }
+
+                clip = render_job.clip();
+            }
+        }
+
+        // a render of an outdated graph is of no use, edits cancel it
+        if ((render_job.isRunning() || draft_job.isRunning()) && isDirty()) {
+            draft_job.cancel();
+            render_job.cancel();
+
+            if (ctx.audio.currentClip(this) == clip) {
+                ctx.audio.stop(this);
+            }
+
+            clip = {};
+        }
+
+        // edits are rendered in the background once they settle, the clip is ready by the time a slider is released
+        if (speculative && !live && isDirty()) {
+            const auto revision = nodes::editRevision();
+            const auto now = std::chrono::steady_clock::now();
+
+            if (revision != last_edit_revision) {
+                last_edit_revision = revision;
+                last_edit_tp = now;
+            } else if (revision != speculated_revision && now - last_edit_tp >= debounce) {
+                speculated_revision = revision;
+
+                if (!isChainInfinite()) {
+                    startRender(ctx);
+
+                    if (auto_audition) {
+                        audition(ctx);
+                    }
+                }
+            }
         }
 
-        if (ctx.audio.currentParrent() == this) {
-            ctx.audio.setVolume(volume);
+        if (ctx.audio.currentLoop(this) != loop) {
+            ctx.audio.setLoop(loop, this);
         }
 
         nk_layout_row_begin(ctx.nk, NK_DYNAMIC, 20, 3);
@@ -39,35 +95,31 @@ struct AudioOutput : public nodes::INode {
             style.text_active.b >>= 1;
             style.text_hover.b >>= 1;
 
-            if (!isDirty() || ctx.audio.currentParrent() != this) {
+            if (!isDirty() || !ctx.audio.hasVoice(this)) {
                 style.text_normal.r >>= 1;
                 style.text_active.r >>= 1;
                 style.text_hover.r >>= 1;
             }
 
             if (nk_button_symbol_styled(ctx.nk, &style, NK_SYMBOL_TRIANGLE_RIGHT)) {
-                if (isDirty() || ctx.audio.currentParrent() != this) {
+                if (live) {
+                    if (startLive(ctx, 0)) {
+                        ctx.audio.setVolume(volume, this);
+                        ctx.audio.play(this);
+                    }
+                } else if (isDirty() || !ctx.audio.hasVoice(this) || ctx.audio.currentClip(this) != clip) {
                     if (const auto stack = isChainInfinite(); stack) {
                         popup_infinite_loop_data = stack;
                     } else {
-                        std::vector<types::Float> clip(sample_size);
+                        // a clean node plays its last render again, it is shared with the player rather than copied
+                        if (isDirty() || !clip) {
+                            startRender(ctx);
+                        }
 
-                        const auto t1 = std::chrono::steady_clock::now();
-                        process(ctx, clip);
-                        const auto t2 = std::chrono::steady_clock::now();
-
-                        us_processing = std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count();
-
-                        ctx.audio.stop();
-                        ctx.audio.setClip(clip, this);
-                        ctx.audio.setVolume(volume);
-                        ctx.audio.play();
-                        ctx.audio.ignoreNextFeedbackTimer();
-
-                        clearDirty();
+                        audition(ctx);
                     }
                 } else {
-                    ctx.audio.play();
+                    ctx.audio.play(this);
                 }
             };
         }
@@ -83,13 +135,17 @@ struct AudioOutput : public nodes::INode {
             style.text_hover.g >>= 1;
 
             if (nk_button_symbol_styled(ctx.nk, &style, NK_SYMBOL_RECT_SOLID)) {
-                ctx.audio.stop();
+                ctx.audio.stop(this);
             }
         }
         {
             nk_layout_row_push(ctx.nk, 0.80f);
 
-            if (isDirty()) {
+            if (draft_job.isRunning()) {
+                nk_prog(ctx.nk, static_cast<nk_size>(draft_job.progress() * 100), 100, false);
+            } else if (render_job.isRunning()) {
+                nk_prog(ctx.nk, static_cast<nk_size>(render_job.progress() * 100), 100, false);
+            } else if (isDirty()) {
                 nk_label(ctx.nk, "Not processed yet", NK_TEXT_ALIGN_LEFT);
             } else {
                 if (us_processing > 1000000) {
@@ -103,8 +159,28 @@ struct AudioOutput : public nodes::INode {
         }
         nk_layout_row_end(ctx.nk);
 
+        // a changed topology replaces the live stream, the new one continues where the old one is
+        if (live_stream && ctx.audio.currentSource(this) == live_stream) {
+            if (live_stream->isOutdated()) {
+                startLive(ctx, ctx.audio.playbackCursor(this));
+            } else {
+                live_stream->update();
+            }
+        }
+
         nk_layout_row_dynamic(ctx.nk, 0, 1);
         {
+            {
+                const auto prev = live;
+                nk_checkbox_label(ctx.nk, "Live", &live);
+
+                if (prev != live && live_stream && ctx.audio.currentSource(this) == live_stream) {
+                    ctx.audio.stop(this);
+                }
+            }
+            nk_checkbox_label(ctx.nk, "Render edits in background", &speculative);
+            nk_checkbox_label(ctx.nk, "Play rendered edits", &auto_audition);
+
             constexpr auto max_seconds = 30;
 
             {
@@ -140,20 +216,54 @@ struct AudioOutput : public nodes::INode {
 
                 if (prev != nk_volume) {
                     volume = nk_volume;
-                    if (ctx.audio.currentParrent() == this) {
-                        ctx.audio.setVolume(volume);
-                    }
+                    ctx.audio.setVolume(volume, this);
+                }
+            }
+            {
+                const auto prev = draft_divider;
+                draft_divider = nk_propertyi(ctx.nk, "Draft rate divider", 1, draft_divider, max_draft_divider, 1, 0.05f);
+                draft_divider = std::min(draft_divider, static_cast<int>(ctx.audio.getSampleRate()));
+
+                if (prev != draft_divider) {
+                    makeDirty();
+                }
+            }
+            {
+                const auto prev = draft_ms;
+                nk_property_float(ctx.nk, "Draft length [ms]", 0.f, &draft_ms, max_seconds * 1000, 1.f, std::max(draft_ms / 100.f, 1.f));
+
+                if (prev != draft_ms) {
+                    makeDirty();
                 }
             }
             { sync_size = nk_propertyi(ctx.nk, "window", 16, sync_size, 2048, 16, 16); }
+            {
+                const char *looping_labels[] = {"once", "loop", "ping-pong"};
+
+                nk_combobox(                                             //
+                    ctx.nk, looping_labels, std::size(looping_labels),   //
+                    reinterpret_cast<int *>(&loop.style), 12, {100, 100} //
+                );
+            }
+            // loop points only change playback, the clip stays valid
+            if (loop.style != audio::AudioSystem::LoopingStyle::NO_LOOPING) {
+                const auto max = static_cast<int>(sample_size);
+
+                loop.begin = static_cast<size_t>(nk_propertyi(ctx.nk, "Loop start [samples]", 0, static_cast<int>(loop.begin), max, 1, 1));
+                loop.end = static_cast<size_t>(nk_propertyi(ctx.nk, "Loop end [samples]", 0, static_cast<int>(loop.end), max, 1, 1));
+
+                if (loop.style == audio::AudioSystem::LoopingStyle::FORWARD) {
+                    loop.crossfade = static_cast<size_t>(nk_propertyi(ctx.nk, "Crossfade [samples]", 0, static_cast<int>(loop.crossfade), max / 2, 1, 1));
+                }
+            }
         }
 
-        std::vector<types::Float> window(sync_size);
+        window.resize(sync_size);
 
-        ctx.audio.getSampleFeedback(window, [&ctx, this] -> std::optional<types::Float> {
-            if (const auto attached = sync.attached()) {
+        ctx.audio.getSampleFeedback(this, window, [&ctx, this] -> std::optional<types::Float> {
+            if (sync.attached()) {
                 std::array<types::Float, 1> value;
-                attached->parent()->process(ctx, value);
+                sync_renderer.render({.sample_rate = ctx.audio.getSampleRate()}, value);
                 return value[0];
             }
 
@@ -175,33 +285,144 @@ struct AudioOutput : public nodes::INode {
         }
     }
 
-    Attachments attachments(Attachments buffer, AttachmentFilter filter) override {
-        return implAttachments(buffer, filter, &input, &sync); //
+    // A draft at a fraction of the sample rate, limited to its length, is rendered and played first if enabled.
+    void startRender(Ctx &ctx) {
+        if (draft_divider > 1) {
+            const auto sample_rate = ctx.audio.getSampleRate();
+            const auto draft_size = draft_ms > 0 ? std::min(sample_size, static_cast<size_t>(draft_ms * 1e-3f * sample_rate)) : sample_size;
+
+            render_job.cancel();
+            draft_job.start(draft_renderer, {.sample_rate = sample_rate / draft_divider}, draft_size, &ctx.thread_pool, draft_divider);
+            clip = draft_job.clip();
+        } else {
+            draft_job.cancel();
+            startFullRender(ctx);
+            clip = render_job.clip();
+        }
+
+        clearDirty();
+    }
+
+    void startFullRender(Ctx &ctx) {
+        render_job.start(input_renderer, {.sample_rate = ctx.audio.getSampleRate()}, sample_size, &ctx.thread_pool); //
+    }
+
+    void audition(Ctx &ctx) {
+        ctx.audio.stop(this);
+        ctx.audio.setClip(clip, this);
+        ctx.audio.setLoop(loop, this);
+        ctx.audio.setVolume(volume, this);
+        ctx.audio.play(this);
+    }
+
+    // Returns false if the input graph contains a cycle.
+    bool startLive(Ctx &ctx, size_t position) {
+        if (const auto stack = isChainInfinite(); stack) {
+            popup_infinite_loop_data = stack;
+            live_stream = nullptr;
+            return false;
+        }
+
+        auto stream = engine::Stream::create(input, {.sample_rate = ctx.audio.getSampleRate()}, position);
+
+        if (!stream) {
+            live_stream = nullptr;
+            return false;
+        }
+
+        live_stream = stream.get();
+        ctx.audio.setSource(std::move(stream), this);
+        return true;
     }
 
+    Attachments listAttachments() override { return {&input, &sync}; }
+
     static constexpr auto k_sample_size = "sample_size";
     static constexpr auto k_sync_size = "sync_size";
     static constexpr auto k_volume = "volume";
+    static constexpr auto k_live = "live";
+    static constexpr auto k_speculative = "speculative";
+    static constexpr auto k_auto_audition = "auto_audition";
+    static constexpr auto k_draft_divider = "draft_divider";
+    static constexpr auto k_draft_ms = "draft_ms";
+    static constexpr auto k_looping = "looping";
+    static constexpr auto k_loop_begin = "loop_begin";
+    static constexpr auto k_loop_end = "loop_end";
+    static constexpr auto k_crossfade = "crossfade";
 
     void serializeData(nlohmann::json &json) override {
         json[k_sample_size] = sample_size;
         json[k_volume] = volume;
         json[k_sync_size] = sync_size;
+        json[k_live] = live;
+        json[k_speculative] = speculative;
+        json[k_auto_audition] = auto_audition;
+        json[k_draft_divider] = draft_divider;
+        json[k_draft_ms] = draft_ms;
+        json[k_looping] = static_cast<int>(loop.style);
+        json[k_loop_begin] = loop.begin;
+        json[k_loop_end] = loop.end;
+        json[k_crossfade] = loop.crossfade;
     }
 
     void deserializeData(const nlohmann::json &json) override {
         sample_size = json.value<size_t>(k_sample_size, 1024);
         volume = json.value<types::Float>(k_volume, 1.f);
         sync_size = json.value<size_t>(k_sync_size, 256);
+        live = json.value<bool>(k_live, false);
+        speculative = json.value<bool>(k_speculative, true);
+        auto_audition = json.value<bool>(k_auto_audition, false);
+        draft_divider = std::clamp(json.value<int>(k_draft_divider, 1), 1, max_draft_divider);
+        draft_ms = json.value<float>(k_draft_ms, 0.f);
+        loop = {
+            .style = static_cast<audio::AudioSystem::LoopingStyle>(std::clamp(json.value<int>(k_looping, 0), 0, 2)),
+            .begin = json.value<size_t>(k_loop_begin, 0),
+            .end = json.value<size_t>(k_loop_end, 0),
+            .crossfade = json.value<size_t>(k_crossfade, 0),
+        };
     }
 
     nodes::Attachment input = nodes::Attachment(this, nodes::Attachment::Role::INPUT, "In");
     nodes::Attachment sync = nodes::Attachment(this, nodes::Attachment::Role::INPUT, "Osc");
 
+    engine::InputRenderer input_renderer = engine::InputRenderer(input, true);
+    engine::InputRenderer sync_renderer = engine::InputRenderer(sync);
+    // drafts use their own plan, a different sample rate would discard the cache of the full quality one
+    engine::InputRenderer draft_renderer = engine::InputRenderer(input);
+
+    // the player starts on the clip while the job is still rendering it
+    engine::RenderJob render_job;
+    engine::RenderJob draft_job;
+    // the draft until the full quality render completes
+    audio::Clip clip;
+    // owned by the audio system, valid while it is the current source
+    engine::Stream *live_stream = nullptr;
+    // voices are only claimed from ui(), the audio system outlives the nodes of its context
+    audio::AudioSystem *audio_system = nullptr;
+
     size_t sample_size = 1024;
     size_t us_processing = 0;
     size_t sync_size = 256;
     types::Float volume = 1.f;
+    bool live = false;
+    bool speculative = true;
+    bool auto_audition = false;
+    // a loop end of 0 is the end of the clip
+    audio::AudioSystem::Loop loop{};
+
+    // 1 disables drafts, a draft length of 0 covers the whole clip
+    static constexpr int max_draft_divider = 8;
+    int draft_divider = 1;
+    float draft_ms = 0.f;
+
+    // nuklear reports no release of a dragged property, the edit revision standing still stands in for it
+    static constexpr auto debounce = std::chrono::milliseconds(150);
+    size_t last_edit_revision = 0;
+    size_t speculated_revision = 0;
+    std::chrono::steady_clock::time_point last_edit_tp;
+
+    // scope window, kept to not allocate every frame
+    std::vector<types::Float> window;
 
     std::optional<std::vector<nodes::INode *>> popup_infinite_loop_data;
 };
@@ -1,6 +1,7 @@
 #include "common.hpp"
 
 #include <audio/filters.hpp>
+#include <audio/triple_buffer.hpp>
 #include <nodes/nodes.hpp>
 #include <nodes/type_info.hpp>
 
@@ -8,8 +9,6 @@
 
 #include <nlohmann/json.hpp>
 
-#include <optional>
-
 namespace {
 struct BiQuadFilter : public nodes::INode {
     BiQuadFilter() : INode(TYPE_INFO_STR(BiQuadFilter), 200, 120) {}
@@ -25,25 +24,41 @@ struct BiQuadFilter : public nodes::INode {
         HighShelf,
     };
 
-    void process(Ctx &ctx, std::span<types::Float> buf) override {
-        input.getInput(ctx, buf);
+    struct Kernel : nodes::Kernel {
+        Kernel(const BiQuadFilter &node) : node(node) {}
 
-        if (!params.has_value()) {
-            calculateParams(ctx);
-        }
+        void prepare(const nodes::RenderInfo &info) override { sample_rate = info.sample_rate; }
 
-        auto bqf = audio::BiQuadFilter<types::Float>(*params);
+        void reset() override { bqf.reset(); }
 
-        for (auto &v : buf) {
-            v = bqf.process(v);
+        // coefficients are computed on the updating thread
+        void update() override {
+            params.back() = node.calculateParams(sample_rate);
+            params.publish();
         }
-    }
 
-    void ui(Ctx &ctx) override {
-        if (!params.has_value()) {
-            calculateParams(ctx);
+        nodes::Signal processBlock(Inputs inputs, std::span<types::Float> buf) override {
+            if (params.acquire()) {
+                bqf.setup(params.front());
+            }
+
+            if (inputs.signal(0).isSilent() && bqf.isAtRest()) {
+                return nodes::Signal::silence();
+            }
+
+            bqf.process(inputs[0], buf);
+            return nodes::Signal::dense();
         }
 
+        const BiQuadFilter &node;
+        audio::TripleBuffer<audio::BiQuadFilter<types::Float>::Params> params;
+        size_t sample_rate = 0;
+        audio::BlockBiQuadFilter<types::Float> bqf = audio::BlockBiQuadFilter<types::Float>({});
+    };
+
+    std::unique_ptr<nodes::Kernel> createKernel() override { return std::make_unique<Kernel>(*this); }
+
+    void ui(Ctx &ctx) override {
         const char *type_labels[] = {
             "Low pass", "High pass", "Band pass", "All pass",   //
             "Notch",    "Peak",      "Low-shelf", "High-shelf", //
@@ -57,10 +72,7 @@ struct BiQuadFilter : public nodes::INode {
                 reinterpret_cast<int *>(&type), 12, {100, 150} //
             );
 
-            if (prev != type) {
-                makeDirty();
-                calculateParams(ctx);
-            }
+            makeDirtyIf(prev != type);
         }
         {
             float value = f0;
@@ -69,7 +81,6 @@ struct BiQuadFilter : public nodes::INode {
             if (value != new_value) {
                 f0 = new_value;
                 makeDirty();
-                calculateParams(ctx);
             }
         }
         {
@@ -79,7 +90,6 @@ struct BiQuadFilter : public nodes::INode {
             if (value != new_value) {
                 q = new_value;
                 makeDirty();
-                calculateParams(ctx);
             }
         }
         if (type == Type::Peak || type == Type::LowShelf || type == Type::HighShelf) {
@@ -89,46 +99,35 @@ struct BiQuadFilter : public nodes::INode {
             if (value != new_value) {
                 gain_db = new_value;
                 makeDirty();
-                calculateParams(ctx);
             }
         }
     }
 
-    void calculateParams(Ctx &ctx) {
-        const auto sr = ctx.audio.getSampleRate();
-
+    audio::BiQuadFilter<types::Float>::Params calculateParams(size_t sr) const {
         switch (type) {
         case Type::LowPass:
-            params = audio::filter::lowPass<types::Float>(sr, f0, q);
-            break;
+            return audio::filter::lowPass<types::Float>(sr, f0, q);
         case Type::HighPass:
-            params = audio::filter::highPass<types::Float>(sr, f0, q);
-            break;
+            return audio::filter::highPass<types::Float>(sr, f0, q);
         case Type::BandPass:
-            params = audio::filter::bandPass<types::Float>(sr, f0, q);
-            break;
+            return audio::filter::bandPass<types::Float>(sr, f0, q);
         case Type::AllPass:
-            params = audio::filter::allPass<types::Float>(sr, f0, q);
-            break;
+            return audio::filter::allPass<types::Float>(sr, f0, q);
         case Type::Notch:
-            params = audio::filter::notch<types::Float>(sr, f0, q);
-            break;
+            return audio::filter::notch<types::Float>(sr, f0, q);
         case Type::Peak:
-            params = audio::filter::peak<types::Float>(sr, f0, q, gain_db);
-            break;
+            return audio::filter::peak<types::Float>(sr, f0, q, gain_db);
         case Type::LowShelf:
-            params = audio::filter::lowShelf<types::Float>(sr, f0, q, gain_db);
-            break;
+            return audio::filter::lowShelf<types::Float>(sr, f0, q, gain_db);
         case Type::HighShelf:
-            params = audio::filter::highShelf<types::Float>(sr, f0, q, gain_db);
-            break;
+            return audio::filter::highShelf<types::Float>(sr, f0, q, gain_db);
         }
-    }
 
-    Attachments attachments(Attachments buffer, AttachmentFilter filter) override {
-        return implAttachments(buffer, filter, &input, &output); //
+        return {};
     }
 
+    Attachments listAttachments() override { return {&input, &output}; }
+
     static constexpr auto k_type = "type";
     static constexpr auto k_gain_db = "gain_db";
     static constexpr auto k_f0 = "f0";
@@ -150,8 +149,6 @@ struct BiQuadFilter : public nodes::INode {
         gain_db = json.value<types::Float>(k_gain_db, 0.f);
         f0 = json.value<types::Float>(k_f0, 1000);
         q = json.value<types::Float>(k_q, 1);
-
-        params = std::nullopt;
     }
 
     nodes::Attachment input = nodes::Attachment(this, nodes::Attachment::Role::INPUT, "In");
@@ -161,8 +158,6 @@ struct BiQuadFilter : public nodes::INode {
     types::Float gain_db = 0.f;
     types::Float f0 = 1000;
     types::Float q = 1;
-
-    std::optional<audio::BiQuadFilter<types::Float>::Params> params;
 };
 } // namespace
 
@@ -1,5 +1,6 @@
 #include "common.hpp"
 
+#include <audio/triple_buffer.hpp>
 #include <nodes/nodes.hpp>
 #include <nodes/type_info.hpp>
 
@@ -7,32 +8,81 @@
 
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <ranges>
+#include <vector>
+
 namespace {
 struct CombFilter : public nodes::INode {
     CombFilter() : INode(TYPE_INFO_STR(CombFilter), 170, 80) {}
 
-    void process(Ctx &ctx, std::span<types::Float> buf) override {
-        input.getInput(ctx, buf);
+    struct Kernel : nodes::Kernel {
+        Kernel(const CombFilter &node) : node(node) {}
+
+        void prepare(const nodes::RenderInfo &info) override {
+            sample_rate = info.sample_rate;
+            // holds past outputs for the longest delay the UI allows
+            history.assign(static_cast<size_t>(std::ceil(sample_rate * max_delay)) + 1, 0.f);
+        }
+
+        void reset() override {
+            std::ranges::fill(history, 0.f);
+            position = 0;
+        }
+
+        void update() override {
+            params.back() = {.fb_decay = node.fb_decay, .fb_delay = node.fb_delay};
+            params.publish();
+        }
+
+        nodes::Signal processBlock(Inputs inputs, std::span<types::Float> buf) override {
+            params.acquire();
+
+            const auto [fb_decay, fb_delay] = params.front();
+            const auto history_size = static_cast<int64_t>(history.size());
+
+            for (auto [in, out] : std::ranges::views::zip(inputs[0], buf)) {
+                const auto bi = position++;
+                const auto src_i = static_cast<int64_t>(std::round(bi - fb_delay * sample_rate));
+                const auto lag = bi - src_i;
 
-        auto src = [&buf](int64_t i) -> types::Float {
-            if (i >= 0 && i < static_cast<int64_t>(buf.size())) {
-                return buf[i];
+                types::Float src = 0;
+
+                if (src_i >= 0 && lag <= 0) {
+                    src = in;
+                } else if (src_i >= 0 && lag < history_size) {
+                    src = history[src_i % history_size];
+                }
+
+                out = in + src * (types::Float(1) - fb_decay);
+                history[bi % history_size] = out;
             }
-            return 0;
+
+            return nodes::Signal::dense();
+        }
+
+        static constexpr types::Float max_delay = 0.999;
+
+        struct Params {
+            types::Float fb_decay = 0;
+            types::Float fb_delay = 0;
         };
 
-        const types::Float sample_rate = ctx.audio.getSampleRate();
+        const CombFilter &node;
+        audio::TripleBuffer<Params> params;
+        types::Float sample_rate = 0;
+        std::vector<types::Float> history;
+        int64_t position = 0;
+    };
 
-        for (int64_t bi = 0; bi < static_cast<int64_t>(buf.size()); ++bi) {
-            buf[bi] = buf[bi] + src(std::round(bi - fb_delay * sample_rate)) * (types::Float(1) - fb_decay);
-        }
-    }
+    std::unique_ptr<nodes::Kernel> createKernel() override { return std::make_unique<Kernel>(*this); }
 
     void ui(Ctx &ctx) override {
         nk_layout_row_dynamic(ctx.nk, 0, 1);
         {
             float value = fb_delay;
-            const auto new_value = nk_propertyf(ctx.nk, "delay", 1e-4, value, 0.999, 1e-3, common::valuePerPx(value));
+            const auto new_value = nk_propertyf(ctx.nk, "delay", min_delay, value, Kernel::max_delay, 1e-3, common::valuePerPx(value));
 
             if (value != new_value) {
                 fb_delay = new_value;
@@ -50,9 +100,9 @@ struct CombFilter : public nodes::INode {
         }
     }
 
-    Attachments attachments(Attachments buffer, AttachmentFilter filter) override {
-        return implAttachments(buffer, filter, &input, &output); //
-    }
+    Attachments listAttachments() override { return {&input, &output}; }
+
+    static constexpr types::Float min_delay = 1e-4;
 
     static constexpr auto k_fb_decay = "fb_decay";
     static constexpr auto k_fb_delay = "fb_delay";
@@ -64,7 +114,8 @@ struct CombFilter : public nodes::INode {
 
     void deserializeData(const nlohmann::json &json) override {
         fb_decay = json.value<types::Float>(k_fb_decay, 0.5);
-        fb_delay = json.value<types::Float>(k_fb_delay, 0.01);
+        // the history of the kernel only holds the longest delay the UI allows, a longer one would feed back silence
+        fb_delay = std::clamp(json.value<types::Float>(k_fb_delay, 0.01), min_delay, Kernel::max_delay);
     }
 
     nodes::Attachment input = nodes::Attachment(this, nodes::Attachment::Role::INPUT, "In");
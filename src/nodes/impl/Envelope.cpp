@@ -1,5 +1,6 @@
 #include "common.hpp"
 
+#include <audio/triple_buffer.hpp>
 #include <nodes/nodes.hpp>
 #include <nodes/type_info.hpp>
 
@@ -7,6 +8,9 @@
 
 #include <Ctx.hpp>
 
+#include <algorithm>
+#include <vector>
+
 namespace {
 struct Envelope : public nodes::INode {
     Envelope() : nodes::INode(TYPE_INFO_STR(Envelope), 200, 300) {}
@@ -19,32 +23,97 @@ struct Envelope : public nodes::INode {
         types::Float len = 0.f;
     };
 
-    void process(Ctx &ctx, std::span<types::Float> buf) override {
-        const auto s_per_step = 1.f / static_cast<types::Float>(ctx.audio.getSampleRate());
-        types::Float tp = 0.f;
-        size_t i = 0;
+    // The envelope is a function of time, so it can be evaluated at control points as well as at every sample.
+    struct Kernel : nodes::Kernel {
+        Kernel(const Envelope &node) : node(node) {}
 
-        for (auto &s : buf) {
-            if (i == points.size() - 1) {
-                s = points.back().vol;
-                continue;
+        void prepare(const nodes::RenderInfo &info) override { sample_rate = static_cast<double>(info.sample_rate); }
+
+        // buffers of the triple buffer are reused, so the reader never releases memory
+        void update() override {
+            auto &[points, starts] = params.back();
+            points = node.points;
+            starts.clear();
+
+            double start = 0;
+
+            for (const auto &point : points) {
+                starts.push_back(start);
+                start += point.len;
             }
 
-            const auto pa = points[i + 0];
-            const auto pb = points[i + 1];
+            params.publish();
+        }
+
+        bool processControl(Inputs inputs, std::span<types::Float> points) override {
+            params.acquire();
 
-            const auto ratio = tp / pa.len;
-            const auto value = pa.vol * (1.f - ratio) + pb.vol * ratio;
-            s = value;
+            if (isOver(inputs)) {
+                return false;
+            }
 
-            tp += s_per_step;
+            const auto first = inputs.position / inputs.control_period;
 
-            if (tp > pa.len) {
-                tp = 0.f;
-                i += 1;
+            for (size_t j = 0; j < points.size(); ++j) {
+                points[j] = valueAt((first + j) * inputs.control_period);
             }
+
+            return true;
         }
-    }
+
+        nodes::Signal processBlock(Inputs inputs, std::span<types::Float> buf) override {
+            params.acquire();
+
+            const auto &points = params.front().points;
+
+            if (points.empty()) {
+                return nodes::Signal::silence();
+            }
+
+            // sustains the last point once the envelope is over
+            if (isOver(inputs)) {
+                return nodes::Signal::constant(points.back().vol);
+            }
+
+            for (size_t i = 0; i < buf.size(); ++i) {
+                buf[i] = valueAt(inputs.position + i);
+            }
+
+            return nodes::Signal::dense();
+        }
+
+        // At control rate the first point of the block decides, so the switch to a constant happens at the same
+        // sample however the stream is split into blocks.
+        bool isOver(const Inputs &inputs) const {
+            const auto &starts = params.front().starts;
+            const auto period = std::max<size_t>(inputs.control_period, 1);
+            return starts.empty() || static_cast<double>(inputs.position / period * period) / sample_rate >= starts.back();
+        }
+
+        types::Float valueAt(size_t sample) const {
+            const auto &[points, starts] = params.front();
+            const auto time = static_cast<double>(sample) / sample_rate;
+            const auto i = static_cast<size_t>(std::ranges::upper_bound(starts, time) - starts.begin()) - 1;
+
+            if (i + 1 >= points.size()) {
+                return points.back().vol;
+            }
+
+            const auto ratio = static_cast<types::Float>((time - starts[i]) / points[i].len);
+            return points[i].vol * (1.f - ratio) + points[i + 1].vol * ratio;
+        }
+
+        struct Params {
+            std::vector<Point> points;
+            std::vector<double> starts;
+        };
+
+        const Envelope &node;
+        audio::TripleBuffer<Params> params;
+        double sample_rate = 1;
+    };
+
+    std::unique_ptr<nodes::Kernel> createKernel() override { return std::make_unique<Kernel>(*this); }
 
     void ui(Ctx &ctx) override {
         nk_layout_row_dynamic(ctx.nk, 0, 1);
@@ -90,9 +159,7 @@ struct Envelope : public nodes::INode {
         }
     }
 
-    Attachments attachments(Attachments buffer, AttachmentFilter filter) override { //
-        return implAttachments(buffer, filter, &output);
-    }
+    Attachments listAttachments() override { return {&output}; }
 
     static constexpr auto k_points = "points";
     static constexpr auto k_vol = "vol";
@@ -5,6 +5,8 @@
 #include <nodes/type_info.hpp>
 
 #include <Ctx.hpp>
+#include <engine/plan.hpp>
+#include <engine/render_job.hpp>
 
 #include <nlohmann/json.hpp>
 
@@ -12,14 +14,25 @@ namespace {
 struct FrequencyResponse : public nodes::INode {
     FrequencyResponse() : INode(TYPE_INFO_STR(FrequencyResponse), 400, 400, true) {}
 
-    void process(Ctx &, std::span<types::Float> buf) override {
-        if (buf.empty()) {
-            return;
+    struct Kernel : nodes::Kernel {
+        void reset() override { first_block = true; }
+
+        nodes::Signal processBlock(Inputs, std::span<types::Float> buf) override {
+            if (!first_block || buf.empty()) {
+                return nodes::Signal::silence();
+            }
+
+            std::fill(buf.begin(), buf.end(), 0);
+            buf[0] = 1;
+            first_block = false;
+
+            return nodes::Signal::dense();
         }
 
-        std::fill(buf.begin(), buf.end(), 0);
-        buf[0] = 1;
-    }
+        bool first_block = true;
+    };
+
+    std::unique_ptr<nodes::Kernel> createKernel() override { return std::make_unique<Kernel>(); }
 
     void ui(Ctx &ctx) override {
         nk_layout_row_dynamic(ctx.nk, 0, 1);
@@ -36,11 +49,21 @@ struct FrequencyResponse : public nodes::INode {
             }
         }
 
+        // the last response stays on screen until a new one is rendered, an edit restarts a running render
         if (isDirty()) {
-            input.getInput(ctx, window_ir);
+            render_job.start(input_renderer, {.sample_rate = ctx.audio.getSampleRate()}, window_ir.size(), &ctx.thread_pool);
+            clearDirty();
+        }
+
+        if (render_job.poll()) {
+            window_ir.assign(render_job.clip().samples().begin(), render_job.clip().samples().end());
             window_fr.resize(window_ir.size() / 2 + 1);
             audio::filter::fft(window_ir, window_fr);
-            clearDirty();
+        }
+
+        if (render_job.isRunning()) {
+            nk_layout_row_dynamic(ctx.nk, 0, 1);
+            nk_prog(ctx.nk, static_cast<nk_size>(render_job.progress() * 100), 100, false);
         }
 
         types::Float abs_max = 0;
@@ -86,9 +109,7 @@ struct FrequencyResponse : public nodes::INode {
         nk_chart_end(ctx.nk);
     }
 
-    Attachments attachments(Attachments buffer, AttachmentFilter filter) override {
-        return implAttachments(buffer, filter, &input, &output); //
-    }
+    Attachments listAttachments() override { return {&input, &output}; }
 
     static constexpr auto k_window_size = "window_size";
 
@@ -107,6 +128,9 @@ struct FrequencyResponse : public nodes::INode {
     nodes::Attachment input = nodes::Attachment(this, nodes::Attachment::Role::INPUT, "IR");
     nodes::Attachment output = nodes::Attachment(this, nodes::Attachment::Role::OUTPUT, "IS", true);
 
+    engine::InputRenderer input_renderer = engine::InputRenderer(input);
+    engine::RenderJob render_job;
+
     std::vector<types::Float> window_ir = std::vector<types::Float>(256);
     std::vector<types::Float> window_fr = std::vector<types::Float>(256);
 };
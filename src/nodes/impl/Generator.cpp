@@ -1,5 +1,6 @@
 #include "common.hpp"
 
+#include <audio/triple_buffer.hpp>
 #include <nodes/nodes.hpp>
 #include <nodes/type_info.hpp>
 
@@ -8,6 +9,8 @@
 #include <nlohmann/json.hpp>
 
 #include <cmath>
+#include <optional>
+#include <ranges>
 
 namespace {
 struct Generator : public nodes::INode {
@@ -23,23 +26,76 @@ struct Generator : public nodes::INode {
         SQUARE,
     };
 
-    void process(Ctx &ctx, std::span<types::Float> buf) override {
-        if (const auto attached = input.attached()) {
-            attached->parent()->process(ctx, buf);
-        } else {
-            std::fill(buf.begin(), buf.end(), 0.f);
+    struct Kernel : nodes::Kernel {
+        Kernel(const Generator &node) : node(node) {}
+
+        void prepare(const nodes::RenderInfo &info) override {
+            inv_sample_rate = 1.f / static_cast<types::Float>(info.sample_rate); //
         }
 
-        const auto inv_sample_rate = 1.f / static_cast<types::Float>(ctx.audio.getSampleRate());
-        auto phase = 0.f;
+        void reset() override {
+            phase = 0.f;
+            ramp_hz.reset();
+        }
 
-        for (auto &v : buf) {
-            const auto rate = v * inv_sample_rate;
-            phase += rate;
-            phase -= std::floor(phase);
-            v = generator(phase);
+        void update() override {
+            params.back() = node.function;
+            params.publish();
         }
-    }
+
+        nodes::Signal processBlock(Inputs inputs, std::span<types::Float> buf) override {
+            if (params.acquire()) {
+                function = params.front();
+            }
+
+            if (const auto hz = inputs.signal(0); hz.isConstant()) {
+                return processRamp(hz.value, buf);
+            }
+
+            ramp_hz.reset();
+
+            for (auto [hz, v] : std::ranges::views::zip(inputs[0], buf)) {
+                const auto rate = hz * inv_sample_rate;
+                phase += rate;
+                phase -= std::floor(phase);
+                v = generator(function, phase);
+            }
+
+            return nodes::Signal::dense();
+        }
+
+        // Constant frequency has a closed-form phase. It is computed from the start of the ramp, so it neither
+        // accumulates rounding errors nor depends on block boundaries.
+        nodes::Signal processRamp(types::Float hz, std::span<types::Float> buf) {
+            if (ramp_hz != hz) {
+                ramp_hz = hz;
+                ramp_phase = phase;
+                ramp_position = 0;
+            }
+
+            const auto rate = static_cast<double>(hz) * inv_sample_rate;
+
+            for (auto &v : buf) {
+                const auto p = ramp_phase + rate * static_cast<double>(++ramp_position);
+                phase = static_cast<types::Float>(p - std::floor(p));
+                v = generator(function, phase);
+            }
+
+            return nodes::Signal::dense();
+        }
+
+        const Generator &node;
+        audio::TripleBuffer<Function> params;
+        Function function = Function::SIN;
+        types::Float inv_sample_rate = 0.f;
+        types::Float phase = 0.f;
+
+        std::optional<types::Float> ramp_hz;
+        double ramp_phase = 0;
+        size_t ramp_position = 0;
+    };
+
+    std::unique_ptr<nodes::Kernel> createKernel() override { return std::make_unique<Kernel>(*this); }
 
     void ui(Ctx &ctx) override {
         const char *function_labels[] = {
@@ -61,11 +117,9 @@ struct Generator : public nodes::INode {
         }
     }
 
-    Attachments attachments(Attachments buffer, AttachmentFilter filter) override { //
-        return implAttachments(buffer, filter, &input, &output);
-    }
+    Attachments listAttachments() override { return {&input, &output}; }
 
-    types::Float generator(types::Float phase) const {
+    static types::Float generator(Function function, types::Float phase) {
         switch (function) {
         case Function::SIN:
             return common::gen::sin(phase);
@@ -1,3 +1,4 @@
+#include <audio/triple_buffer.hpp>
 #include <nodes/nodes.hpp>
 #include <nodes/type_info.hpp>
 
@@ -5,8 +6,11 @@
 
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <ranges>
+#include <vector>
 
 namespace {
 struct Math : public nodes::INode {
@@ -14,57 +18,120 @@ struct Math : public nodes::INode {
 
     enum class Type : int { Mul, Add, Sub, Sin, Cos, Sqr, Cub, SqrSat };
 
-    void process(Ctx &ctx, std::span<types::Float> buf) override {
-        switch (type) {
-        case Type::Mul:
-        case Type::Add:
-        case Type::Sub:
-            processXY(ctx, buf);
-            break;
-        case Type::Sin:
-        case Type::Cos:
-        case Type::Sqr:
-        case Type::Cub:
-        case Type::SqrSat:
-            processX(ctx, buf);
-            break;
-        }
-    }
+    struct Kernel : nodes::Kernel {
+        Kernel(const Math &node) : node(node) {}
 
-    void processX(Ctx &ctx, std::span<types::Float> buf) {
-        const auto out = std::span(buf);
-        const auto in_x = std::span(buf);
+        void prepare(const nodes::RenderInfo &info) override {
+            for (auto &buffer : scratch) {
+                buffer.resize(info.block_size + 2);
+            }
+        }
 
-        if (const auto attached = input_x.attached()) {
-            attached->parent()->process(ctx, in_x);
-        } else {
-            std::fill(in_x.begin(), in_x.end(), 0.f);
+        void update() override {
+            params.back() = node.type;
+            params.publish();
         }
 
-        function(in_x, {}, out);
-    }
+        bool readsControl() const override { return true; }
+
+        // control-rate inputs mixed only with constants stay at control rate
+        bool processControl(Inputs inputs, std::span<types::Float> points) override {
+            params.acquire();
+
+            const auto type = params.front();
+            auto any_control = false;
+
+            for (size_t i = 0; i < inputs.size(); ++i) {
+                if (!inputs.signal(i).isControl() && !inputs.signal(i).isConstant()) {
+                    return false;
+                }
+
+                any_control |= inputs.signal(i).isControl();
+            }
+
+            if (!any_control) {
+                return false;
+            }
 
-    void processXY(Ctx &ctx, std::span<types::Float> buf) {
-        std::vector<types::Float> buf_2(buf.size());
+            auto operand = [&](size_t i) -> std::span<const types::Float> {
+                if (i >= inputs.size()) {
+                    return {};
+                }
 
-        const auto out = std::span(buf);
-        const auto in_x = std::span(buf);
-        const auto in_y = std::span(buf_2);
+                if (inputs.signal(i).isControl()) {
+                    return inputs.control(i).first(points.size());
+                }
 
-        if (const auto attached = input_x.attached()) {
-            attached->parent()->process(ctx, in_x);
-        } else {
-            std::fill(in_x.begin(), in_x.end(), 0.f);
+                const auto constant = std::span(scratch[i]).first(points.size());
+                std::ranges::fill(constant, inputs.signal(i).value);
+                return constant;
+            };
+
+            function(type, operand(0), operand(1), points);
+            return true;
         }
 
-        if (const auto attached = input_y.attached()) {
-            attached->parent()->process(ctx, in_y);
-        } else {
-            std::fill(in_y.begin(), in_y.end(), 0.f);
+        nodes::Signal processBlock(Inputs inputs, std::span<types::Float> buf) override {
+            params.acquire();
+
+            const auto type = params.front();
+            const auto x = inputs.signal(0);
+            const auto y = inputs.size() > 1 ? inputs.signal(1) : nodes::Signal::silence();
+
+            // samples of control-rate inputs are not interpolated for kernels reading control points
+            auto samples = [&](size_t i) -> std::span<const types::Float> {
+                if (!inputs.signal(i).isControl()) {
+                    return inputs[i];
+                }
+
+                const auto interpolated = std::span(scratch[i]).first(buf.size());
+                nodes::interpolateControl(inputs.control(i), inputs.position, inputs.control_period, interpolated);
+                return interpolated;
+            };
+
+            switch (type) {
+            case Type::Mul:
+                if (x.isSilent() || y.isSilent()) {
+                    return nodes::Signal::silence();
+                }
+                [[fallthrough]];
+            case Type::Add:
+            case Type::Sub:
+                if (x.isConstant() && y.isConstant()) {
+                    return fold(x.value, y.value);
+                }
+
+                function(type, samples(0), samples(1), buf);
+                break;
+            case Type::Sin:
+            case Type::Cos:
+            case Type::Sqr:
+            case Type::Cub:
+            case Type::SqrSat:
+                if (x.isConstant()) {
+                    return fold(x.value, 0);
+                }
+
+                function(type, samples(0), {}, buf);
+                break;
+            }
+
+            return nodes::Signal::dense();
         }
 
-        function(in_x, in_y, out);
-    }
+        // same function applied to a single sample, so folded constants match the per-sample result
+        nodes::Signal fold(types::Float x, types::Float y) const {
+            types::Float o = 0;
+            function(params.front(), std::span(&x, 1), std::span(&y, 1), std::span(&o, 1));
+            return nodes::Signal::constant(o);
+        }
+
+        const Math &node;
+        audio::TripleBuffer<Type> params;
+        std::array<std::vector<types::Float>, 2> scratch;
+    };
+
+    std::unique_ptr<nodes::Kernel> createKernel() override { return std::make_unique<Kernel>(*this); }
 
     void ui(Ctx &ctx) override {
         const char *type_labels[] = {
@@ -80,7 +147,11 @@ struct Math : public nodes::INode {
                 ctx.nk, type_labels, std::size(type_labels),   //
                 reinterpret_cast<int *>(&type), 12, {100, 150} //
             );
-            makeDirtyIf(prev != type);
+
+            if (prev != type) {
+                makeDirty();
+                invalidateAttachments();
+            }
         }
 
         switch (type) {
@@ -98,23 +169,23 @@ struct Math : public nodes::INode {
         }
     }
 
-    Attachments attachments(Attachments buffer, AttachmentFilter filter) override {
+    Attachments listAttachments() override {
         switch (type) {
         case Type::Mul:
         case Type::Add:
         case Type::Sub:
-            return implAttachments(buffer, filter, &input_x, &input_y, &output);
+            return {&input_x, &input_y, &output};
         case Type::Sin:
         case Type::Cos:
         case Type::Sqr:
         case Type::Cub:
         case Type::SqrSat:
-            return implAttachments(buffer, filter, &input_x, &output);
+            return {&input_x, &output};
             break;
         }
     }
 
-    void function(std::span<const types::Float> x, std::span<const types::Float> y, std::span<types::Float> o) const {
+    static void function(Type type, std::span<const types::Float> x, std::span<const types::Float> y, std::span<types::Float> o) {
         switch (type) {
         case Type::Mul:
             functionImpl(x, y, o, [](types::Float x, types::Float y) { return x * y; });
@@ -143,13 +214,13 @@ struct Math : public nodes::INode {
         }
     }
 
-    void functionImpl(std::span<const types::Float> xs, std::span<const types::Float> ys, std::span<types::Float> os, auto fn) const {
+    static void functionImpl(std::span<const types::Float> xs, std::span<const types::Float> ys, std::span<types::Float> os, auto fn) {
         for (auto [x, y, o] : std::ranges::views::zip(xs, ys, os)) {
             o = fn(x, y);
         }
     }
 
-    void functionImpl(std::span<const types::Float> xs, std::span<types::Float> os, auto fn) const {
+    static void functionImpl(std::span<const types::Float> xs, std::span<types::Float> os, auto fn) {
         for (auto [x, o] : std::ranges::views::zip(xs, os)) {
             o = fn(x);
         }
@@ -23,11 +23,8 @@ struct Splitter : public nodes::INode {
         }
     }
 
-    void process(Ctx &ctx, std::span<types::Float> buf) override {
-        if (const auto attached = input.attached()) {
-            attached->parent()->process(ctx, buf);
-        }
-    }
+    std::unique_ptr<nodes::Kernel> createKernel() override { return nullptr; }
+    nodes::Attachment *passthrough() override { return &input; }
 
     void ui(Ctx &ctx) override {
         nk_layout_row_dynamic(ctx.nk, 0, 1);
@@ -41,6 +38,10 @@ struct Splitter : public nodes::INode {
     }
 
     void adjustSize(size_t size) {
+        if (size == outputs.size()) {
+            return;
+        }
+
         while (size < outputs.size()) {
             outputs.pop_back();
         }
@@ -48,19 +49,21 @@ struct Splitter : public nodes::INode {
         while (size > outputs.size()) {
             pushOutput();
         }
+
+        invalidateAttachments();
     }
 
-    Attachments attachments(Attachments buffer, AttachmentFilter filter) override {
-        std::vector<nodes::Attachment *> list_helper;
+    Attachments listAttachments() override {
+        Attachments list;
 
-        list_helper.reserve(1 + outputs.size());
-        list_helper.push_back(&input);
+        list.reserve(1 + outputs.size());
+        list.push_back(&input);
 
         for (auto &output : outputs) {
-            list_helper.push_back(&output);
+            list.push_back(&output);
         }
 
-        return implAttachmentsDynamic(std::move(buffer), filter, list_helper);
+        return list;
     }
 
     void serializeData(nlohmann::json &kvl) override {
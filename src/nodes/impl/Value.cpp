@@ -1,5 +1,6 @@
 #include "common.hpp"
 
+#include <audio/triple_buffer.hpp>
 #include <nodes/nodes.hpp>
 #include <nodes/type_info.hpp>
 
@@ -15,9 +16,24 @@ struct Value : public nodes::INode {
 
     enum class Type : int { Value, Note };
 
-    void process(Ctx &, std::span<types::Float> buf) override {
-        std::fill(buf.begin(), buf.end(), getValue()); //
-    }
+    struct Kernel : nodes::Kernel {
+        Kernel(const Value &node) : node(node) {}
+
+        void update() override {
+            value.back() = node.getValue();
+            value.publish();
+        }
+
+        nodes::Signal processBlock(Inputs, std::span<types::Float>) override {
+            value.acquire();
+            return nodes::Signal::constant(value.front());
+        }
+
+        const Value &node;
+        audio::TripleBuffer<types::Float> value;
+    };
+
+    std::unique_ptr<nodes::Kernel> createKernel() override { return std::make_unique<Kernel>(*this); }
 
     types::Float getValue() const {
         switch (type) {
@@ -69,9 +85,7 @@ struct Value : public nodes::INode {
         }
     }
 
-    Attachments attachments(Attachments buffer, AttachmentFilter filter) override {
-        return implAttachments(buffer, filter, &output); //
-    }
+    Attachments listAttachments() override { return {&output}; }
 
     static constexpr auto k_type = "type";
     static constexpr auto k_value = "value";
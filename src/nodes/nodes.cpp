@@ -2,10 +2,169 @@
 
 #include <Utl.hpp>
 
+#include <algorithm>
 #include <format>
+#include <optional>
+#include <span>
 #include <vector>
 
 namespace nodes {
+namespace {
+size_t g_topology_revision = 0;
+size_t g_edit_revision = 0;
+
+std::vector<INode *> g_nodes;
+std::vector<INode *> g_order;
+bool g_order_valid = false;
+
+// traversals mark nodes with the current epoch instead of keeping a visited set
+size_t g_epoch = 0;
+std::vector<INode *> g_queue;
+std::vector<size_t> g_degrees;
+} // namespace
+
+size_t topologyRevision() { return g_topology_revision; }
+size_t editRevision() { return g_edit_revision; }
+
+struct Topology {
+    static void add(INode &node) {
+        node.m_index = g_nodes.size();
+        g_nodes.push_back(&node);
+        g_order_valid = false;
+    }
+
+    static void remove(INode &node) {
+        g_nodes.back()->m_index = node.m_index;
+        std::swap(g_nodes[node.m_index], g_nodes.back());
+        g_nodes.pop_back();
+        g_order_valid = false;
+    }
+
+    static void link(const Attachment &input, const Attachment &output) {
+        input.parent()->m_producers.push_back({output.parent(), output.terminating});
+        output.parent()->m_consumers.push_back({input.parent(), output.terminating});
+        g_order_valid = false;
+        ++g_topology_revision;
+    }
+
+    static void unlink(const Attachment &input, const Attachment &output) {
+        auto &producers = input.parent()->m_producers;
+        auto &consumers = output.parent()->m_consumers;
+        producers.erase(std::ranges::find(producers, INode::Link{output.parent(), output.terminating}));
+        consumers.erase(std::ranges::find(consumers, INode::Link{input.parent(), output.terminating}));
+        g_order_valid = false;
+        ++g_topology_revision;
+    }
+
+    /// Kahn's algorithm, nodes left with unresolved producers are on a cycle.
+    static std::span<INode *const> order() {
+        if (g_order_valid) {
+            return g_order;
+        }
+
+        g_order.clear();
+        g_degrees.assign(g_nodes.size(), 0);
+
+        for (const auto &node : g_nodes) {
+            g_degrees[node->m_index] = std::ranges::count(node->m_producers, false, &INode::Link::terminating);
+
+            if (g_degrees[node->m_index] == 0) {
+                g_order.push_back(node);
+            }
+        }
+
+        for (size_t i = 0; i < g_order.size(); ++i) {
+            for (const auto &link : g_order[i]->m_consumers) {
+                if (!link.terminating && --g_degrees[link.node->m_index] == 0) {
+                    g_order.push_back(link.node);
+                }
+            }
+        }
+
+        g_order_valid = true;
+        return g_order;
+    }
+
+    /// Visits every node reachable from the origin once. Upstream traversal visits producers of terminating outputs,
+    /// but does not continue past them.
+    static void traverse(INode &origin, Attachment::Role role, auto func) {
+        const auto epoch = ++g_epoch;
+
+        g_queue.clear();
+        g_queue.push_back(&origin);
+        origin.m_visit = epoch;
+
+        for (size_t i = 0; i < g_queue.size(); ++i) {
+            const auto node = g_queue[i];
+            func(node);
+
+            for (const auto &link : role == Attachment::Role::OUTPUT ? node->m_consumers : node->m_producers) {
+                if (link.node->m_visit == epoch) {
+                    continue;
+                }
+
+                if (role == Attachment::Role::INPUT && link.terminating) {
+                    func(link.node);
+                    continue;
+                }
+
+                link.node->m_visit = epoch;
+                g_queue.push_back(link.node);
+            }
+        }
+    }
+
+    /// Depth-first search upstream, returns the path from the origin to the first node found twice on it.
+    static std::optional<std::vector<INode *>> findCycle(INode &origin) {
+        // on path nodes are marked with the epoch, finished nodes with the epoch + 1
+        g_epoch += 2;
+        const auto on_path = g_epoch - 1;
+        const auto finished = g_epoch;
+
+        struct Frame {
+            INode *node;
+            size_t next = 0;
+        };
+
+        std::vector<Frame> stack{{&origin}};
+        origin.m_visit = on_path;
+
+        while (!stack.empty()) {
+            auto &top = stack.back();
+
+            if (top.next == top.node->m_producers.size()) {
+                top.node->m_visit = finished;
+                stack.pop_back();
+                continue;
+            }
+
+            const auto &link = top.node->m_producers[top.next++];
+
+            if (link.terminating || link.node->m_visit == finished) {
+                continue;
+            }
+
+            if (link.node->m_visit == on_path) {
+                std::vector<INode *> path;
+
+                for (const auto &frame : stack) {
+                    path.push_back(frame.node);
+                }
+
+                path.push_back(link.node);
+                return path;
+            }
+
+            link.node->m_visit = on_path;
+            stack.push_back({link.node});
+        }
+
+        return std::nullopt;
+    }
+};
+
+std::span<INode *const> topologicalOrder() { return Topology::order(); }
+
 Attachment::Attachment(INode *parent, Role role, std::string name, bool terminating)     //
     : name(std::move(name)), role(role), terminating(terminating), m_parent(parent) //
 {
@@ -19,116 +178,122 @@ void Attachment::attach(Attachment &other) {
         return;
     }
 
-    detach();
-    other.detach();
-    other.m_attached = this;
-    m_attached = &other;
-    m_parent->makeDirty();
-}
+    auto &input = role == Role::INPUT ? *this : other;
+    auto &output = role == Role::INPUT ? other : *this;
 
-void Attachment::detach() {
-    if (m_attached) {
-        m_attached->m_parent->makeDirty();
-        m_attached->m_attached = nullptr;
-        m_parent->makeDirty();
-        m_attached = nullptr;
+    if (input.attached() == &output) {
+        return;
     }
-}
 
-INode *Attachment::parent() const { return utl::assertNotNull(m_parent); }
+    input.detach();
+    input.m_peers.push_back(&output);
+    output.m_peers.push_back(&input);
+    Topology::link(input, output);
+    input.m_parent->makeDirty();
+}
 
-Attachment *Attachment::attached() const { return m_attached; }
+void Attachment::detach() {
+    if (m_peers.empty()) {
+        return;
+    }
 
-void Attachment::getInput(Ctx &ctx, std::span<types::Float> output) const {
-    assert(role != Attachment::Role::OUTPUT);
+    for (const auto &peer : m_peers) {
+        std::erase(peer->m_peers, this);
 
-    if (m_attached == nullptr) {
-        for (auto &value : output) {
-            value = 0.f;
+        if (peer->role == Role::INPUT) {
+            Topology::unlink(*peer, *this);
+            peer->m_parent->makeDirty();
+        } else {
+            Topology::unlink(*this, *peer);
         }
-
-        return;
     }
 
-    m_attached->parent()->process(ctx, output);
+    m_peers.clear();
+    m_parent->makeDirty();
 }
 
-INode::~INode() = default;
+INode *Attachment::parent() const { return utl::assertNotNull(m_parent); }
 
-INode::Attachments INode::implAttachmentsDynamic( //
-    Attachments output,                           //
-    AttachmentFilter filter,                      //
-    std::span<Attachment *> aps                   //
-) {
-    output.clear();
-    output.reserve(aps.size());
+Attachment *Attachment::attached() const { return m_peers.empty() ? nullptr : m_peers.front(); }
 
-    for (const auto &ap : aps) {
-        if (filter.has_value() && *filter != ap->role) {
-            continue;
-        }
+Kernel::~Kernel() = default;
 
-        output.push_back(ap);
+size_t controlPointCount(size_t position, size_t length, size_t period) {
+    if (length == 0) {
+        return 0;
     }
 
-    return output;
+    return (position + length - 1) / period - position / period + 2;
 }
 
-std::string INode::uniqueName() const { return std::format("{}_{}", name, static_cast<const void *>(this)); }
+void interpolateControl(std::span<const types::Float> points, size_t position, size_t period, std::span<types::Float> output) {
+    const auto inv_period = 1.f / static_cast<types::Float>(period);
 
-namespace {
-std::optional<std::vector<INode *>> safeForEachInChain(           //
-    std::vector<INode *> &stack, Attachment::Role role, auto func //
-) {
-    assert(!stack.empty());
-
-    const auto top = stack.back();
+    for (size_t i = 0; i < output.size();) {
+        const auto point = (position + i) / period - position / period;
+        const auto offset = (position + i) % period;
+        const auto from = points[point];
+        const auto slope = (points[point + 1] - from) * inv_period;
+        const auto count = std::min(period - offset, output.size() - i);
 
-    func(top);
+        for (size_t j = 0; j < count; ++j) {
+            output[i + j] = from + slope * static_cast<types::Float>(offset + j);
+        }
 
-    if (std::any_of(stack.begin(), stack.end() - 1, [top](const auto &v) { return v == top; })) {
-        return stack;
+        i += count;
     }
+}
 
-    for (auto &attachment : top->attachments({}, role)) {
-        if (const auto attached = attachment->attached()) {
-            stack.push_back(attached->parent());
+INode::INode(std::string name, size_t w, size_t h, bool reversed) //
+    : name(std::move(name)), ui_width(w), ui_height(h), reversed(reversed) {
+    Topology::add(*this);
+}
 
-            if (attached->terminating) {
-                func(attached->parent());
-                return std::nullopt;
-            }
+INode::~INode() { Topology::remove(*this); }
 
-            if (const auto opt_stack = safeForEachInChain(stack, role, func)) {
-                return opt_stack;
-            }
+const INode::Attachments &INode::attachments(AttachmentFilter filter) {
+    if (!m_attachments_valid) {
+        m_attachments = listAttachments();
+        m_inputs.clear();
+        m_outputs.clear();
 
-            stack.pop_back();
+        for (const auto &attachment : m_attachments) {
+            (attachment->role == Attachment::Role::INPUT ? m_inputs : m_outputs).push_back(attachment);
         }
+
+        m_attachments_valid = true;
+    }
+
+    if (!filter.has_value()) {
+        return m_attachments;
     }
 
-    return std::nullopt;
+    return *filter == Attachment::Role::INPUT ? m_inputs : m_outputs;
 }
 
-std::optional<std::vector<INode *>> safeForEachInChain( //
-    INode *node, Attachment::Role role, auto func       //
-) {
-    std::vector<INode *> stack;
-    stack.reserve(16);
-    stack.push_back(node);
-    return safeForEachInChain(stack, role, func);
+void INode::invalidateAttachments() {
+    m_attachments_valid = false;
+    ++g_topology_revision;
 }
-} // namespace
+
+std::string INode::uniqueName() const { return std::format("{}_{}", name, static_cast<const void *>(this)); }
 
 void INode::makeDirty() {
-    safeForEachInChain(this, Attachment::Role::OUTPUT, [](INode *p) { p->m_dirty = true; });
+    m_revision += 1;
+    g_edit_revision += 1;
+    Topology::traverse(*this, Attachment::Role::OUTPUT, [](INode *p) { p->m_dirty = true; });
 }
 
 void INode::clearDirty() {
-    safeForEachInChain(this, Attachment::Role::INPUT, [](INode *p) { p->m_dirty = false; });
+    Topology::traverse(*this, Attachment::Role::INPUT, [](INode *p) { p->m_dirty = false; });
 }
 
 std::optional<std::vector<INode *>> INode::isChainInfinite() {
-    return safeForEachInChain(this, Attachment::Role::INPUT, [](INode *) {});
+    // every node is ordered only if there is no cycle anywhere
+    if (Topology::order().size() == g_nodes.size()) {
+        return std::nullopt;
+    }
+
+    return Topology::findCycle(*this);
 }
 } // namespace nodes
@@ -26,13 +26,14 @@ struct Attachment {
     Attachment(Attachment &&) = delete;
     Attachment &operator=(Attachment &&) = delete;
 
+    /// INPUT accepts a single peer and drops the previous one, OUTPUT feeds any number of inputs.
     void attach(Attachment &other);
     void detach();
 
     INode *parent() const;
+    /// First peer, for INPUT this is the only one.
     Attachment *attached() const;
-
-    void getInput(Ctx &, std::span<types::Float> output) const;
+    std::span<Attachment *const> peers() const { return m_peers; }
 
     const std::string name;
     const Role role;
@@ -40,9 +41,104 @@ struct Attachment {
 
 private:
     INode *m_parent;
-    Attachment *m_attached = nullptr;
+    std::vector<Attachment *> m_peers;
+};
+
+struct RenderInfo {
+    size_t sample_rate;
+    // small enough for all intermediate buffers of a plan to stay in cache
+    size_t block_size = 512;
+    // samples per control point of control-rate signals, 0 renders everything at audio rate
+    size_t control_period = 32;
+
+    bool operator==(const RenderInfo &) const = default;
+};
+
+/// What is known about a block of samples, lets kernels skip per-sample work on constant, silent or slowly varying
+/// input. A control-rate block is described by control points, see Kernel::processControl.
+struct Signal {
+    enum class Kind { DENSE, CONSTANT, CONTROL };
+
+    Kind kind = Kind::DENSE;
+    // every sample of a constant block
+    types::Float value = 0;
+
+    static constexpr Signal dense() { return {}; }
+    static constexpr Signal constant(types::Float value) { return {.kind = Kind::CONSTANT, .value = value}; }
+    static constexpr Signal silence() { return constant(0); }
+    static constexpr Signal control() { return {.kind = Kind::CONTROL}; }
+
+    bool isConstant() const { return kind == Kind::CONSTANT; }
+    bool isSilent() const { return isConstant() && value == 0; }
+    bool isControl() const { return kind == Kind::CONTROL; }
+
+    bool operator==(const Signal &) const = default;
+};
+
+/// Signal processing part of a node. Kernels are created and owned by a compiled engine::Plan, inputs are resolved
+/// before the kernel runs and come in the same order as the INPUT attachments of the node.
+///
+/// A render is a stream of blocks: prepare() once per render info, reset() before the first block, then
+/// processBlock() for consecutive blocks. Kernel state persists between blocks, so output must not depend on how
+/// the stream is split into blocks. Processing may happen on another thread than the one owning the nodes, so
+/// kernels never read their node while processing. update() publishes parameters through an audio::TripleBuffer,
+/// processing acquires the latest ones at the start of a block.
+struct Kernel {
+    struct Inputs {
+        std::span<const std::span<const types::Float>> blocks;
+        std::span<const Signal> signals;
+        // control points of control-rate inputs, point j is the value at sample (position / period + j) * period
+        std::span<const std::span<const types::Float>> controls;
+
+        // stream position of the first sample of the block
+        size_t position;
+        size_t control_period;
+
+        size_t size() const { return blocks.size(); }
+        std::span<const types::Float> operator[](size_t index) const { return blocks[index]; }
+        const Signal &signal(size_t index) const { return signals[index]; }
+        std::span<const types::Float> control(size_t index) const { return controls[index]; }
+    };
+
+    virtual ~Kernel();
+
+    virtual void prepare(const RenderInfo &) {}
+    virtual void reset() {}
+
+    /// Publishes parameters of the node. Called after prepare() and whenever the node may have changed, always on the
+    /// thread owning the node, possibly while the kernel is processing on another thread.
+    virtual void update() {}
+
+    /// Inputs and output have the same size, at most RenderInfo::block_size samples. Input samples are valid unless
+    /// the input is control-rate and the kernel reads control points. Returns what is known about the output;
+    /// a kernel returning a constant must leave the output untouched, the plan fills it only if it does not hold
+    /// that constant already.
+    virtual Signal processBlock(Inputs inputs, std::span<types::Float> output) = 0;
+
+    /// Tried before processBlock when control rate is enabled. A kernel producing a slowly varying signal writes
+    /// controlPointCount() points and returns true, the plan interpolates them linearly for readers of samples.
+    virtual bool processControl(Inputs, std::span<types::Float> /* points */) { return false; }
+
+    /// Kernels reading Inputs::controls of control-rate inputs do not need their samples.
+    virtual bool readsControl() const { return false; }
 };
 
+/// Control points covering samples [position, position + length), including the one after the last sample.
+size_t controlPointCount(size_t position, size_t length, size_t period);
+
+/// Linear interpolation of control points as laid out in Kernel::Inputs::controls.
+void interpolateControl(std::span<const types::Float> points, size_t position, size_t period, std::span<types::Float> output);
+
+/// Incremented on every attach/detach or change of the input set of any node.
+size_t topologyRevision();
+
+/// Incremented by makeDirty() of any node, tells when the graph was last edited.
+size_t editRevision();
+
+/// Every live node, producers before their consumers. Nodes on a cycle are left out, links from terminating
+/// outputs do not count. Recomputed in O(V+E) on first use after the graph changes.
+std::span<INode *const> topologicalOrder();
+
 struct INode {
     const std::string name;
     const size_t ui_width;
@@ -53,8 +149,7 @@ struct INode {
         float x = 100, y = 100, w = 0, h = 0;
     } space;
 
-    INode(std::string name, size_t w, size_t h, bool reversed = false) //
-        : name(std::move(name)), ui_width(w), ui_height(h), reversed(reversed) {}
+    INode(std::string name, size_t w, size_t h, bool reversed = false);
 
     virtual ~INode();
 
@@ -64,8 +159,13 @@ struct INode {
     INode &operator=(INode &&) = delete;
 
     bool isDirty() const { return m_dirty; };
+    /// Incremented by makeDirty on the node that changed, unlike the dirty flag it is never cleared by consumers.
+    size_t revision() const { return m_revision; }
 
-    virtual void process(Ctx &ctx, std::span<types::Float> output) = 0;
+    /// Returns nullptr for nodes that do not produce any signal.
+    virtual std::unique_ptr<Kernel> createKernel() = 0;
+    /// INPUT attachment forwarded unchanged to all outputs, such nodes share the buffer of their input.
+    virtual Attachment *passthrough() { return nullptr; }
     virtual void ui(Ctx &ctx) = 0;
 
     virtual void serializeData(nlohmann::json &) = 0;
@@ -87,29 +187,41 @@ struct INode {
     using Attachments = std::vector<Attachment *>;
     using AttachmentFilter = std::optional<Attachment::Role>;
 
-    virtual Attachments attachments(Attachments = {}, AttachmentFilter = {}) = 0;
+    /// Cached list, stays valid until the set of attachments of the node changes.
+    const Attachments &attachments(AttachmentFilter = {});
 
 protected:
     void clearDirty();
 
-    static Attachments implAttachmentsDynamic( //
-        Attachments output,                    //
-        AttachmentFilter filter,               //
-        std::span<Attachment *> aps            //
-    );
-
-    template <typename... Ts>
-    static Attachments implAttachments( //
-        Attachments output,             //
-        AttachmentFilter filter,        //
-        Ts... aps                       //
-    ) {
-        std::array<Attachment *, sizeof...(aps)> arr({aps...});
-        return implAttachmentsDynamic(output, filter, std::span(arr));
-    }
+    /// Lists attachments of the node, inputs and outputs in display order. Called only to rebuild the cache.
+    virtual Attachments listAttachments() = 0;
+
+    /// Must be called when the set of attachments changes, e.g. ports are added or hidden.
+    void invalidateAttachments();
 
 private:
+    friend struct Topology;
+
+    // one link per attached pair of attachments, maintained by Attachment::attach and detach
+    struct Link {
+        INode *node;
+        bool terminating;
+
+        bool operator==(const Link &) const = default;
+    };
+
     bool m_dirty = true;
+    size_t m_revision = 0;
+
+    std::vector<Link> m_producers;
+    std::vector<Link> m_consumers;
+    size_t m_index;
+    size_t m_visit = 0;
+
+    Attachments m_attachments;
+    Attachments m_inputs;
+    Attachments m_outputs;
+    bool m_attachments_valid = false;
 };
 
 std::unique_ptr<INode> audioOutput();
@@ -5,6 +5,8 @@
 
 #include <nodes/nodes.hpp>
 
+#include <format>
+
 void ui::menuBar(Ctx &ctx) {
     style::pushMenuBar(ctx);
     DEFER(style::popMenuBar(ctx));
@@ -75,6 +77,42 @@ void ui::menuBar(Ctx &ctx) {
         nk_menu_end(ctx.nk);
     }
 
+    nk_layout_row_push(ctx.nk, 50);
+    if (nk_menu_begin_label(ctx.nk, "Audio", NK_TEXT_LEFT, nk_vec2(150, 300))) {
+        nk_layout_row_dynamic(ctx.nk, 20, 1);
+        nk_label(ctx.nk, "Sample rate", NK_TEXT_LEFT);
+
+        for (const auto rate : audio::DeviceConfig::sample_rates) {
+            const auto label = std::format("{:.1f} kHz", static_cast<float>(rate) * 1e-3f);
+
+            if (nk_option_label(ctx.nk, label.c_str(), ctx.audio_config.sample_rate == rate)) {
+                ctx.audio_config.sample_rate = rate;
+            }
+        }
+
+        nk_label(ctx.nk, "Buffer size", NK_TEXT_LEFT);
+
+        for (const auto frames : audio::DeviceConfig::buffer_sizes) {
+            const auto label = std::format("{} samples", frames);
+
+            if (nk_option_label(ctx.nk, label.c_str(), ctx.audio_config.buffer_frames == frames)) {
+                ctx.audio_config.buffer_frames = frames;
+            }
+        }
+
+        nk_menu_end(ctx.nk);
+    }
+
+    nk_layout_row_push(ctx.nk, 400);
+    {
+        const auto stats = ctx.audio_monitor.stats();
+        const auto ms_per_sample = 1e3f / static_cast<float>(ctx.audio.getSampleRate());
+
+        nk_labelf(ctx.nk, NK_TEXT_LEFT, "Latency: %.1f ms (device %.1f ms), callback: %.1f ms (max %.1f ms)", //
+                  static_cast<float>(stats.latency) * ms_per_sample, static_cast<float>(stats.device_frames) * ms_per_sample,
+                  static_cast<float>(stats.period.count()) * 1e-6f, static_cast<float>(stats.max_period.count()) * 1e-6f);
+    }
+
     nk_layout_row_end(ctx.nk);
     nk_menubar_end(ctx.nk);
     nk_end(ctx.nk);
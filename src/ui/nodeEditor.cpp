@@ -4,7 +4,7 @@
 #include <Utl.hpp>
 
 namespace {
-template <typename T> size_t indexOf(const std::vector<T *> vec, T *ptr) {
+template <typename T> size_t indexOf(const std::vector<T *> &vec, T *ptr) {
     for (size_t i = 0; i < vec.size(); ++i) {
         if (vec[i] == ptr) {
             return i;
@@ -87,7 +87,7 @@ void drawCurve(                                     //
 
 void drawLink(                                                              //
     struct nk_command_buffer *canvas, struct nk_rect bounds,                //
-    nodes::INode::Attachments &scratch_buf, nodes::Attachment *attachment,  //
+    nodes::Attachment *attachment,                                          //
     float input_spacing, size_t index, struct nk_color color, bool i_invert //
 ) {
     const auto attached = attachment->attached();
@@ -96,8 +96,7 @@ void drawLink(                                                              //
         return;
     }
 
-    auto &target_points = scratch_buf;
-    target_points = attached->parent()->attachments(std::move(target_points), Role::OUTPUT);
+    const auto &target_points = attached->parent()->attachments(Role::OUTPUT);
 
     const auto o_invert = attached->parent()->reversed;
 
@@ -156,8 +155,6 @@ void ui::nodeEditor(Ctx &ctx) {
         .h = static_cast<float>(ctx.window_size_y),
     };
 
-    std::vector<nodes::Attachment *> scratch_buf_a;
-    std::vector<nodes::Attachment *> scratch_buf_b;
     std::vector<nodes::INode *> nodes_to_remove;
 
     bool dragging_active = false;
@@ -176,11 +173,9 @@ void ui::nodeEditor(Ctx &ctx) {
 
         const auto unique_name = node->uniqueName();
 
-        scratch_buf_a = node->attachments(std::move(scratch_buf_a));
-
         float max_text_width = 0.f;
 
-        for (const auto &attachment : scratch_buf_a) {
+        for (const auto &attachment : node->attachments()) {
             const auto text_width = ctx.nk->style.font->width( //
                 ctx.nk->style.font->userdata,                  //
                 ctx.nk->style.font->height,                    //
@@ -222,14 +217,14 @@ void ui::nodeEditor(Ctx &ctx) {
             nk_push_scissor(canvas, window_box);
 
             auto handleAttachments = [&](Role role) {
-                scratch_buf_a = node->attachments(std::move(scratch_buf_a), role);
-                const auto spacing = attachmentSpacing(bounds.h, scratch_buf_a.size());
+                const auto &attachments = node->attachments(role);
+                const auto spacing = attachmentSpacing(bounds.h, attachments.size());
 
                 const auto invert = node->reversed;
                 const auto invert_role = role == Role::OUTPUT ? Role::INPUT : Role::OUTPUT;
 
-                for (size_t i = 0; i < scratch_buf_a.size(); ++i) {
-                    const auto &attachment = scratch_buf_a[i];
+                for (size_t i = 0; i < attachments.size(); ++i) {
+                    const auto &attachment = attachments[i];
 
                     struct nk_rect c = circleRect(i, spacing, bounds, invert ? invert_role : role);
                     nk_fill_circle(canvas, c, circleColor(ctx.nk, c));
@@ -258,7 +253,7 @@ void ui::nodeEditor(Ctx &ctx) {
                     }
 
                     drawLink(                                                 //
-                        canvas, bounds, scratch_buf_b, attachment,            //
+                        canvas, bounds, attachment,                           //
                         spacing, i, ctx.nk->style.window.border_color, invert //
                     );
                 }
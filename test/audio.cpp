@@ -0,0 +1,582 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <audio/audio.hpp>
+#include <audio/clip.hpp>
+#include <audio/device.hpp>
+#include <audio/queue.hpp>
+#include <audio/triple_buffer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+SCENARIO("SpscQueue") {
+    GIVEN("an empty queue") {
+        auto queue = audio::SpscQueue<int, 4>{};
+
+        THEN("nothing can be popped") {
+            CHECK(queue.peek() == nullptr);
+            CHECK(!queue.pop());
+        }
+
+        THEN("items come out in order and capacity is respected") {
+            for (int i = 0; i < 4; ++i) {
+                CHECK(queue.push(i));
+            }
+
+            CHECK(!queue.push(4));
+            CHECK(*queue.peek() == 0);
+
+            for (int i = 0; i < 4; ++i) {
+                CHECK(queue.pop() == i);
+            }
+
+            CHECK(queue.push(5));
+            CHECK(queue.pop() == 5);
+        }
+    }
+
+    GIVEN("a producer and a consumer thread") {
+        auto queue = audio::SpscQueue<size_t, 8>{};
+        static constexpr size_t count = 100000;
+
+        THEN("every item arrives once and in order") {
+            std::thread producer([&] {
+                for (size_t i = 0; i < count; ++i) {
+                    while (!queue.push(i)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+
+            size_t expected = 0;
+            auto in_order = true;
+
+            while (expected < count) {
+                if (const auto value = queue.pop()) {
+                    in_order &= *value == expected++;
+                }
+            }
+
+            producer.join();
+            CHECK(in_order);
+        }
+    }
+}
+
+SCENARIO("TripleBuffer") {
+    GIVEN("a triple buffer") {
+        auto buffer = audio::TripleBuffer<int>{};
+
+        THEN("nothing is acquired before a publish") {
+            CHECK(!buffer.acquire());
+            CHECK(buffer.front() == 0);
+        }
+
+        THEN("the reader gets the latest published value once") {
+            buffer.back() = 1;
+            buffer.publish();
+            buffer.back() = 2;
+            buffer.publish();
+
+            CHECK(buffer.acquire());
+            CHECK(buffer.front() == 2);
+            CHECK(!buffer.acquire());
+            CHECK(buffer.front() == 2);
+        }
+    }
+
+    GIVEN("a writer and a reader thread") {
+        struct Pair {
+            size_t a = 0;
+            size_t b = 0;
+        };
+
+        auto buffer = audio::TripleBuffer<Pair>{};
+        static constexpr size_t count = 100000;
+
+        THEN("values are never torn and never go back in time") {
+            std::thread writer([&] {
+                for (size_t i = 1; i <= count; ++i) {
+                    buffer.back() = {i, i};
+                    buffer.publish();
+                }
+            });
+
+            auto consistent = true;
+            size_t last = 0;
+
+            while (last < count) {
+                buffer.acquire();
+                const auto [a, b] = buffer.front();
+                consistent &= a == b && a >= last;
+                last = a;
+            }
+
+            writer.join();
+            CHECK(consistent);
+        }
+    }
+}
+
+SCENARIO("Clip") {
+    GIVEN("rendered samples") {
+        std::vector<types::Float> samples(1024, 0.5f);
+        const auto data = samples.data();
+
+        const auto clip = audio::Clip(std::move(samples));
+
+        THEN("the clip takes over the buffer and copies share it") {
+            const auto copy = clip;
+
+            CHECK(clip.samples().data() == data);
+            CHECK(copy.samples().data() == data);
+            CHECK(copy == clip);
+            CHECK(copy.size() == 1024);
+        }
+
+        THEN("a written clip grows while it is shared") {
+            auto writer = audio::ClipWriter(4);
+            const auto growing = writer.clip();
+
+            CHECK(growing.size() == 4);
+            CHECK(growing.samples().empty());
+            CHECK(!growing.isComplete());
+
+            writer.pending()[0] = 1;
+            writer.commit(1);
+
+            CHECK(growing.samples().size() == 1);
+            CHECK(growing.samples()[0] == 1);
+            CHECK(writer.pending().size() == 3);
+
+            writer.commit(3);
+            CHECK(growing.isComplete());
+        }
+
+        THEN("an empty clip has no samples") {
+            CHECK(audio::Clip().empty());
+            CHECK(!audio::Clip());
+            CHECK(audio::Clip() != clip);
+        }
+    }
+}
+
+SCENARIO("AudioSystem") {
+    GIVEN("a clip") {
+        auto audio = audio::AudioSystem(1000);
+        std::array<types::OutFloat, 8> samples;
+
+        const auto clip = audio::Clip({0.25f, 0.5f, 0.75f, 2.f});
+        audio.setClip(clip, &audio);
+
+        THEN("nothing plays before play is called") {
+            audio.getSamples(samples);
+
+            CHECK(audio.hasVoice(&audio));
+            CHECK(audio.currentClip(&audio) == clip);
+            CHECK(audio.currentClip(&audio).samples().data() == clip.samples().data());
+            CHECK(!audio.isPlaying(&audio));
+            CHECK(samples == decltype(samples){});
+        }
+
+        THEN("commands take effect on the next callback") {
+            audio.play(&audio, 1);
+            CHECK(!audio.isPlaying(&audio));
+
+            audio.getSamples(std::span(samples).first(2));
+
+            CHECK(audio.isPlaying(&audio));
+            CHECK(audio.playbackCursor(&audio) == 3);
+            CHECK(samples[0] == 0.5f);
+            CHECK(samples[1] == 0.75f);
+
+            AND_THEN("playback clamps and stops at the end of the clip") {
+                audio.getSamples(samples);
+
+                CHECK(samples[0] == 1.f);
+                CHECK(samples[1] == 0.f);
+                CHECK(!audio.isPlaying(&audio));
+            }
+
+            AND_THEN("stop silences the output") {
+                audio.stop(&audio);
+                audio.getSamples(samples);
+
+                CHECK(!audio.isPlaying(&audio));
+                CHECK(samples == decltype(samples){});
+            }
+        }
+
+        THEN("the scope shows the samples just before the audible one") {
+            const auto ramp = audio::Clip({0.f, 0.1f, 0.2f, 0.3f, 0.4f, 0.5f, 0.6f, 0.7f, 0.8f, 0.9f});
+            std::array<types::Float, 2> window;
+
+            audio.setClip(ramp, &audio);
+            audio.play(&audio);
+            audio.getSamples(samples, 11);
+
+            CHECK(audio.playbackCursor(&audio) == 8);
+            CHECK(audio.audibleCursor(&audio) == 0);
+
+            audio.getSamples(std::span(samples).first(2), 5);
+            audio.getSampleFeedback(&audio, window, std::nullopt);
+
+            CHECK(audio.audibleCursor(&audio) == 5);
+            CHECK(window[0] == 0.3f);
+            CHECK(window[1] == 0.4f);
+        }
+
+        THEN("more commands than the queue holds are delivered in order") {
+            for (int i = 0; i < 200; ++i) {
+                audio.setClip(audio::Clip({static_cast<types::Float>(i) / 1000}), &audio);
+                audio.play(&audio);
+            }
+
+            for (int i = 0; i < 32; ++i) {
+                audio.getSampleFeedback(&audio, {}, std::nullopt);
+                audio.getSamples({});
+            }
+
+            audio.getSamples(std::span(samples).first(1));
+            CHECK(std::abs(samples[0] - 0.199f) < 1e-6f);
+        }
+    }
+
+    GIVEN("clips of several parents") {
+        auto audio = audio::AudioSystem(1000);
+        std::array<types::OutFloat, 8> samples;
+        std::array<int, audio::AudioSystem::voice_count + 1> parents{};
+
+        auto play = [&](const void *parent, types::Float value) {
+            audio.setClip(audio::Clip(std::vector<types::Float>(100000, value)), parent);
+            audio.play(parent);
+        };
+
+        THEN("they are mixed") {
+            play(&parents[0], 0.25f);
+            play(&parents[1], 0.5f);
+            audio.getSamples(samples);
+
+            CHECK(samples[0] == 0.75f);
+            CHECK(audio.isPlaying(&parents[0]));
+            CHECK(audio.isPlaying(&parents[1]));
+
+            audio.stop(&parents[0]);
+            audio.getSamples(samples);
+
+            CHECK(samples[0] == 0.5f);
+            CHECK(!audio.isPlaying(&parents[0]));
+        }
+
+        THEN("the limiter keeps the mix within range") {
+            play(&parents[0], 0.8f);
+            play(&parents[1], 0.8f);
+            audio.getSamples(samples);
+
+            CHECK(std::ranges::all_of(samples, [](auto s) { return std::abs(s - 1.f) < 1e-6f; }));
+        }
+
+        THEN("volume changes are ramped") {
+            play(&parents[0], 0.5f);
+            audio.getSamples(samples);
+            audio.setVolume(0.5f, &parents[0]);
+            audio.getSamples(samples);
+
+            CHECK(samples[0] < 0.5f);
+            CHECK(samples[0] > 0.49f);
+
+            std::array<types::OutFloat, 10000> settled;
+            audio.getSamples(settled);
+
+            CHECK(std::abs(settled.back() - 0.25f) < 1e-3f);
+        }
+
+        THEN("a parent without a voice takes over a stopped one, else the one started first") {
+            for (size_t i = 0; i < audio::AudioSystem::voice_count; ++i) {
+                play(&parents[i], 0.01f);
+            }
+
+            audio.stop(&parents[5]);
+            audio.getSamples(samples);
+            play(&parents.back(), 0.01f);
+
+            CHECK(!audio.hasVoice(&parents[5]));
+            CHECK(audio.hasVoice(&parents.back()));
+
+            audio.getSamples(samples);
+            play(&parents[5], 0.01f);
+
+            CHECK(!audio.hasVoice(&parents[0]));
+            CHECK(audio.hasVoice(&parents[5]));
+        }
+
+        THEN("a released parent loses its voice and it goes silent") {
+            play(&parents[0], 0.25f);
+            play(&parents[1], 0.5f);
+            audio.getSamples(samples);
+            audio.release(&parents[0]);
+            audio.getSamples(samples);
+
+            CHECK(!audio.hasVoice(&parents[0]));
+            CHECK(!audio.isPlaying(&parents[0]));
+            CHECK(audio.currentClip(&parents[0]).empty());
+            CHECK(samples[0] == 0.5f);
+
+            AND_THEN("a parent at the same address starts on a fresh voice") {
+                audio.setClip(audio::Clip({0.125f}), &parents[0]);
+                audio.getSamples(samples);
+
+                CHECK(!audio.isPlaying(&parents[0]));
+                CHECK(audio.currentLoop(&parents[0]) == audio::AudioSystem::Loop{});
+                CHECK(samples[0] == 0.5f);
+            }
+        }
+    }
+
+    GIVEN("a looped clip") {
+        auto audio = audio::AudioSystem(1000);
+        std::array<types::OutFloat, 10> samples;
+
+        audio.setClip(audio::Clip({0.f, 0.1f, 0.2f, 0.3f, 0.4f, 0.5f}), &audio);
+
+        auto played = [&](std::array<types::OutFloat, 10> expected) {
+            audio.play(&audio);
+            audio.getSamples(samples);
+
+            for (size_t i = 0; i < samples.size(); ++i) {
+                CHECK(std::abs(samples[i] - expected[i]) < 1e-6f);
+            }
+
+            CHECK(audio.isPlaying(&audio));
+        };
+
+        THEN("a forward loop jumps from its end to its beginning") {
+            audio.setLoop({.style = audio::AudioSystem::LoopingStyle::FORWARD, .begin = 2, .end = 5}, &audio);
+            played({0.f, 0.1f, 0.2f, 0.3f, 0.4f, 0.2f, 0.3f, 0.4f, 0.2f, 0.3f});
+        }
+
+        THEN("a ping-pong loop turns around at its ends") {
+            audio.setLoop({.style = audio::AudioSystem::LoopingStyle::PING_PONG, .begin = 1, .end = 4}, &audio);
+            played({0.f, 0.1f, 0.2f, 0.3f, 0.2f, 0.1f, 0.2f, 0.3f, 0.2f, 0.1f});
+        }
+
+        THEN("a ping-pong loop starting at the beginning of the clip turns around there") {
+            audio.setLoop({.style = audio::AudioSystem::LoopingStyle::PING_PONG, .begin = 0, .end = 3}, &audio);
+            played({0.f, 0.1f, 0.2f, 0.1f, 0.f, 0.1f, 0.2f, 0.1f, 0.f, 0.1f});
+        }
+
+        THEN("a single sample ping-pong loop holds its sample") {
+            audio.setLoop({.style = audio::AudioSystem::LoopingStyle::PING_PONG, .begin = 0, .end = 1}, &audio);
+            played({});
+            CHECK(audio.playbackCursor(&audio) == 0);
+
+            audio.setLoop({.style = audio::AudioSystem::LoopingStyle::PING_PONG, .begin = 3, .end = 4}, &audio);
+            played({0.f, 0.1f, 0.2f, 0.3f, 0.3f, 0.3f, 0.3f, 0.3f, 0.3f, 0.3f});
+            CHECK(audio.playbackCursor(&audio) == 3);
+        }
+
+        THEN("the audible sample is found through a forward loop that wrapped within the latency") {
+            audio.setLoop({.style = audio::AudioSystem::LoopingStyle::FORWARD, .begin = 2, .end = 5}, &audio);
+            audio.play(&audio);
+
+            // cursors 0 1 2 3 4 2 3 4 2 3 4 2
+            for (int i = 0; i < 3; ++i) {
+                audio.getSamples(std::span(samples).first(4), 6);
+            }
+
+            CHECK(audio.playbackCursor(&audio) == 3);
+            CHECK(audio.audibleCursor(&audio) == 3);
+        }
+
+        THEN("the audible sample is found in the reverse half of a ping-pong loop") {
+            audio.setLoop({.style = audio::AudioSystem::LoopingStyle::PING_PONG, .begin = 1, .end = 4}, &audio);
+            audio.play(&audio);
+
+            // cursors 0 1 2 3 2 1 2 3 2 1
+            audio.getSamples(samples, 5);
+            CHECK(audio.audibleCursor(&audio) == 1);
+
+            audio.getSamples(std::span(samples).first(0), 6);
+            CHECK(audio.audibleCursor(&audio) == 2);
+        }
+
+        THEN("a crossfade blends the end of the loop into the samples after its beginning") {
+            audio.setLoop({.style = audio::AudioSystem::LoopingStyle::FORWARD, .crossfade = 2}, &audio);
+            played({0.f, 0.1f, 0.2f, 0.3f, 0.3f, 0.2f, 0.2f, 0.3f, 0.3f, 0.2f});
+        }
+
+        THEN("the crossfade of a growing clip is prepared once the end of the loop is rendered") {
+            auto writer = audio::ClipWriter(6);
+            std::ranges::copy(std::array{0.f, 0.1f, 0.2f}, writer.pending().begin());
+            writer.commit(3);
+
+            audio.setClip(writer.clip(), &audio);
+            audio.setLoop({.style = audio::AudioSystem::LoopingStyle::FORWARD, .crossfade = 2}, &audio);
+
+            std::ranges::copy(std::array{0.3f, 0.4f, 0.5f}, writer.pending().begin());
+            writer.commit(3);
+            audio.getSampleFeedback(&audio, {}, std::nullopt);
+
+            played({0.f, 0.1f, 0.2f, 0.3f, 0.3f, 0.2f, 0.2f, 0.3f, 0.3f, 0.2f});
+        }
+
+        THEN("the loop applies to clips set later") {
+            audio.setLoop({.style = audio::AudioSystem::LoopingStyle::FORWARD, .begin = 2, .end = 5}, &audio);
+            audio.setClip(audio::Clip({0.5f, 0.4f, 0.3f, 0.2f, 0.1f, 0.f}), &audio);
+            played({0.5f, 0.4f, 0.3f, 0.2f, 0.1f, 0.3f, 0.2f, 0.1f, 0.3f, 0.2f});
+        }
+    }
+
+    GIVEN("a clip still being rendered") {
+        auto audio = audio::AudioSystem(1000);
+        auto writer = audio::ClipWriter(200);
+        std::array<types::OutFloat, 10> samples;
+
+        std::ranges::fill(writer.pending(), 0.5f);
+        writer.commit(20);
+
+        audio.setClip(writer.clip(), &audio);
+        audio.play(&audio);
+        audio.getSamples(samples);
+
+        THEN("playback waits for the headroom") {
+            CHECK(audio.isPlaying(&audio));
+            CHECK(audio.playbackCursor(&audio) == 0);
+            CHECK(samples == decltype(samples){});
+        }
+
+        THEN("playback starts once enough is rendered and ends with the complete clip") {
+            writer.commit(60);
+            audio.getSamples(samples);
+
+            CHECK(audio.playbackCursor(&audio) == 10);
+            CHECK(samples[0] == 0.5f);
+
+            writer.commit(writer.pending().size());
+
+            for (int i = 0; i < 20; ++i) {
+                audio.getSamples(samples);
+            }
+
+            CHECK(!audio.isPlaying(&audio));
+            CHECK(audio.playbackCursor(&audio) == 200);
+        }
+    }
+
+    GIVEN("a live source") {
+        struct Ramp : audio::Source {
+            Ramp(bool &destroyed) : destroyed(destroyed) {}
+            ~Ramp() override { destroyed = true; }
+
+            void render(std::span<types::Float> output) override {
+                for (auto &s : output) {
+                    s = static_cast<types::Float>(next++) / 100;
+                }
+            }
+
+            bool &destroyed;
+            size_t next = 0;
+        };
+
+        auto audio = audio::AudioSystem(1000);
+        std::array<types::OutFloat, 4> samples;
+        auto destroyed = false;
+
+        audio.setSource(std::make_unique<Ramp>(destroyed), &audio);
+        audio.play(&audio);
+        audio.getSamples(samples);
+
+        THEN("samples are pulled from the source") {
+            CHECK(audio.currentSource(&audio) != nullptr);
+            CHECK(audio.playbackCursor(&audio) == 4);
+            CHECK(samples[3] == 0.03f);
+        }
+
+        THEN("a replaced source is released on the UI thread") {
+            audio.setClip(audio::Clip({0.5f}), &audio);
+            audio.getSamples(samples);
+
+            CHECK(!destroyed);
+            CHECK(audio.currentSource(&audio) == nullptr);
+
+            audio.getSampleFeedback(&audio, {}, std::nullopt);
+            CHECK(destroyed);
+        }
+
+        THEN("a released source is no longer pulled and is freed on the UI thread") {
+            audio.release(&audio);
+            audio.getSamples(samples);
+
+            CHECK(!audio.hasVoice(&audio));
+            CHECK(samples == decltype(samples){});
+            CHECK(!destroyed);
+
+            audio.getSampleFeedback(&audio, {}, std::nullopt);
+            CHECK(destroyed);
+        }
+    }
+
+    GIVEN("an audio thread running concurrently with the UI thread") {
+        auto audio = audio::AudioSystem(44100);
+        std::atomic<bool> running = true;
+        std::atomic<bool> valid = true;
+
+        std::thread audio_thread([&] {
+            std::array<types::OutFloat, 128> samples;
+
+            while (running.load()) {
+                audio.getSamples(samples);
+
+                // every clip is filled with a single value in [0, 1]
+                for (auto s : samples) {
+                    if (s < 0 || s > 1.f + 1e-5f) {
+                        valid = false;
+                    }
+                }
+            }
+        });
+
+        THEN("clips are swapped and released without races") {
+            std::array<types::Float, 64> window;
+
+            for (int i = 0; i < 2000; ++i) {
+                audio.setClip(audio::Clip(std::vector<types::Float>(256, static_cast<types::Float>(i % 100) / 100)), &audio);
+                audio.setVolume(1.f, &audio);
+                audio.play(&audio);
+                audio.getSampleFeedback(&audio, window, std::nullopt);
+            }
+
+            running = false;
+            audio_thread.join();
+
+            CHECK(valid);
+        }
+    }
+}
+
+SCENARIO("DeviceMonitor") {
+    audio::DeviceMonitor monitor;
+    monitor.setDeviceFrames(256);
+
+    THEN("latency counts the device buffer") { CHECK(monitor.record(100) == 356); }
+
+    THEN("statistics appear once a window of callbacks is recorded") {
+        CHECK(monitor.stats().period.count() == 0);
+
+        for (int i = 0; i < 100; ++i) {
+            (void)monitor.record(44);
+        }
+
+        const auto stats = monitor.stats();
+
+        CHECK(stats.latency == 300);
+        CHECK(stats.device_frames == 256);
+        CHECK(stats.period.count() > 0);
+        CHECK(stats.max_period >= stats.period);
+    }
+}
@@ -0,0 +1,790 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <engine/plan.hpp>
+#include <engine/render_job.hpp>
+#include <engine/stream.hpp>
+#include <engine/thread_pool.hpp>
+#include <nodes/nodes.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace nodes;
+
+namespace {
+struct Source : public INode {
+    Source(types::Float value) : INode("Source", 0, 0), value(value) {}
+
+    struct Kernel : nodes::Kernel {
+        Kernel(Source &node) : node(node) {}
+
+        Signal processBlock(Inputs, std::span<types::Float> output) override {
+            node.runs += 1;
+            std::ranges::fill(output, node.value);
+            return Signal::dense();
+        }
+
+        Source &node;
+    };
+
+    std::unique_ptr<nodes::Kernel> createKernel() override { return std::make_unique<Kernel>(*this); }
+    void ui(Ctx &) override {}
+
+    Attachments listAttachments() override { return {&output}; }
+
+    void serializeData(nlohmann::json &) override {}
+    void deserializeData(const nlohmann::json &) override {}
+
+    Attachment output = Attachment(this, Attachment::Role::OUTPUT, "Out");
+
+    types::Float value;
+    size_t runs = 0;
+};
+
+struct Add : public INode {
+    Add() : INode("Add", 0, 0) {}
+
+    struct Kernel : nodes::Kernel {
+        Signal processBlock(Inputs inputs, std::span<types::Float> output) override {
+            for (size_t i = 0; i < output.size(); ++i) {
+                output[i] = inputs[0][i] + inputs[1][i];
+            }
+
+            return Signal::dense();
+        }
+    };
+
+    std::unique_ptr<nodes::Kernel> createKernel() override { return std::make_unique<Kernel>(); }
+    void ui(Ctx &) override {}
+
+    Attachments listAttachments() override { return {&x, &y, &output}; }
+
+    void serializeData(nlohmann::json &) override {}
+    void deserializeData(const nlohmann::json &) override {}
+
+    Attachment x = Attachment(this, Attachment::Role::INPUT, "X");
+    Attachment y = Attachment(this, Attachment::Role::INPUT, "Y");
+    Attachment output = Attachment(this, Attachment::Role::OUTPUT, "Out");
+};
+
+struct Forward : public INode {
+    Forward() : INode("Forward", 0, 0) {}
+
+    std::unique_ptr<nodes::Kernel> createKernel() override { return nullptr; }
+    Attachment *passthrough() override { return &input; }
+    void ui(Ctx &) override {}
+
+    Attachments listAttachments() override { return {&input, &output}; }
+
+    void serializeData(nlohmann::json &) override {}
+    void deserializeData(const nlohmann::json &) override {}
+
+    Attachment input = Attachment(this, Attachment::Role::INPUT, "In");
+    Attachment output = Attachment(this, Attachment::Role::OUTPUT, "Out");
+};
+
+struct Sink : public INode {
+    Sink() : INode("Sink", 0, 0) {}
+
+    std::unique_ptr<nodes::Kernel> createKernel() override { return nullptr; }
+    void ui(Ctx &) override {}
+
+    Attachments listAttachments() override { return {&input}; }
+
+    void serializeData(nlohmann::json &) override {}
+    void deserializeData(const nlohmann::json &) override {}
+
+    Attachment input = Attachment(this, Attachment::Role::INPUT, "In");
+};
+
+constexpr RenderInfo info = {.sample_rate = 44100};
+
+Attachment &port(INode &node, Attachment::Role role, size_t index = 0) { return *node.attachments(role).at(index); }
+} // namespace
+
+SCENARIO("Plan") {
+    Source a(1), b(2);
+    Add add_1, add_2;
+    Sink sink;
+
+    GIVEN("detached sink") {
+        auto plan = engine::Plan::compile(sink.input);
+        REQUIRE(plan.has_value());
+
+        THEN("plan is empty and renders silence") {
+            CHECK(plan->stepCount() == 0);
+
+            std::array<types::Float, 4> out{1, 1, 1, 1};
+            plan->run(info, out);
+
+            CHECK(out == std::array<types::Float, 4>{0, 0, 0, 0});
+        }
+    }
+
+    GIVEN("two level graph with a detached input") {
+        add_1.x.attach(a.output);
+        add_1.y.attach(b.output);
+        add_2.x.attach(add_1.output);
+        sink.input.attach(add_2.output);
+
+        auto plan = engine::Plan::compile(sink.input);
+        REQUIRE(plan.has_value());
+
+        THEN("every node is scheduled once") { CHECK(plan->stepCount() == 4); }
+
+        THEN("output is computed in a single pass") {
+            std::array<types::Float, 4> out{};
+            plan->run(info, out);
+
+            CHECK(out == std::array<types::Float, 4>{3, 3, 3, 3});
+            CHECK(a.runs == 1);
+            CHECK(b.runs == 1);
+        }
+
+        THEN("plan becomes stale when attachments change") {
+            CHECK_FALSE(plan->isStale());
+            add_2.y.attach(b.output);
+            CHECK(plan->isStale());
+        }
+    }
+
+    GIVEN("output feeding several inputs") {
+        Forward forward;
+
+        forward.input.attach(a.output);
+        add_1.x.attach(a.output);
+        add_1.y.attach(forward.output);
+        sink.input.attach(add_1.output);
+
+        auto plan = engine::Plan::compile(sink.input);
+        REQUIRE(plan.has_value());
+
+        THEN("shared producer is rendered once and passthrough has no step") {
+            std::array<types::Float, 4> out{};
+            plan->run(info, out);
+
+            CHECK(plan->stepCount() == 2);
+            CHECK(out == std::array<types::Float, 4>{2, 2, 2, 2});
+            CHECK(a.runs == 1);
+        }
+    }
+
+    GIVEN("long chain") {
+        std::array<Add, 8> chain;
+        chain[0].x.attach(a.output);
+
+        for (size_t i = 1; i < chain.size(); ++i) {
+            chain[i].x.attach(chain[i - 1].output);
+            chain[i].y.attach(b.output);
+        }
+
+        sink.input.attach(chain.back().output);
+
+        auto plan = engine::Plan::compile(sink.input);
+        REQUIRE(plan.has_value());
+
+        THEN("dead buffers are reused") {
+            CHECK(plan->slotCount() == 4);
+
+            std::array<types::Float, 4> out{};
+            plan->run(info, out);
+
+            CHECK(out == std::array<types::Float, 4>{15, 15, 15, 15});
+        }
+    }
+
+    GIVEN("graph with a cycle") {
+        add_1.x.attach(add_2.output);
+        add_2.x.attach(add_1.output);
+
+        THEN("compilation fails") { CHECK_FALSE(engine::Plan::compile(add_1.x).has_value()); }
+    }
+}
+
+SCENARIO("Incremental rendering") {
+    Source a(1), b(2), c(3);
+    Add add_1, add_2;
+    Sink sink;
+
+    add_1.x.attach(a.output);
+    add_1.y.attach(b.output);
+    add_2.x.attach(add_1.output);
+    add_2.y.attach(c.output);
+    sink.input.attach(add_2.output);
+
+    auto plan = engine::Plan::compile(sink.input);
+    REQUIRE(plan.has_value());
+    plan->setCaching(true);
+
+    std::array<types::Float, 4> out{};
+    plan->run(info, out);
+
+    REQUIRE(out == std::array<types::Float, 4>{6, 6, 6, 6});
+
+    GIVEN("nothing changed") {
+        out = {};
+        plan->run(info, out);
+
+        THEN("output is replayed from cache") {
+            CHECK(out == std::array<types::Float, 4>{6, 6, 6, 6});
+            CHECK(a.runs == 1);
+            CHECK(b.runs == 1);
+            CHECK(c.runs == 1);
+        }
+    }
+
+    GIVEN("node next to the sink changed") {
+        c.value = 5;
+        c.makeDirty();
+        plan->run(info, out);
+
+        THEN("the first change renders the clean producers once") {
+            CHECK(out == std::array<types::Float, 4>{8, 8, 8, 8});
+            CHECK(a.runs == 2);
+            CHECK(b.runs == 2);
+            CHECK(c.runs == 2);
+        }
+
+        AND_WHEN("it changes again") {
+            c.value = 6;
+            c.makeDirty();
+            plan->run(info, out);
+
+            THEN("only the changed node is processed") {
+                CHECK(out == std::array<types::Float, 4>{9, 9, 9, 9});
+                CHECK(a.runs == 2);
+                CHECK(b.runs == 2);
+                CHECK(c.runs == 3);
+            }
+        }
+    }
+
+    GIVEN("node deep in the graph changed twice") {
+        a.value = 4;
+        a.makeDirty();
+        plan->run(info, out);
+        a.value = 5;
+        a.makeDirty();
+        plan->run(info, out);
+
+        THEN("clean siblings are replayed") {
+            CHECK(out == std::array<types::Float, 4>{10, 10, 10, 10});
+            CHECK(a.runs == 3);
+            CHECK(b.runs == 2);
+            CHECK(c.runs == 2);
+        }
+
+        THEN("only the sink and the edge of the change are cached") { CHECK(plan->cacheSize() == 3 * out.size()); }
+    }
+
+    GIVEN("chains of different depth, edited in the middle") {
+        auto memory = [](size_t depth) {
+            Source source(1), offset(2);
+            std::vector<Add> chain(depth);
+            Sink end;
+
+            chain[0].x.attach(source.output);
+
+            for (size_t i = 1; i < chain.size(); ++i) {
+                chain[i].x.attach(chain[i - 1].output);
+                chain[i].y.attach(offset.output);
+            }
+
+            end.input.attach(chain.back().output);
+
+            auto chain_plan = engine::Plan::compile(end.input);
+            chain_plan->setCaching(true);
+
+            std::vector<types::Float> output(1000);
+            chain_plan->run(info, output);
+
+            for (int edit = 0; edit < 2; ++edit) {
+                chain[depth / 2].makeDirty();
+                chain_plan->run(info, output);
+            }
+
+            return std::pair(chain_plan->slotCount(), chain_plan->cacheSize());
+        };
+
+        THEN("slot and cache memory does not grow with the depth") { CHECK(memory(8) == memory(64)); }
+    }
+
+    GIVEN("longer render") {
+        std::array<types::Float, 8> longer{};
+        plan->run(info, longer);
+
+        THEN("everything is processed again") {
+            CHECK(longer == std::array<types::Float, 8>{6, 6, 6, 6, 6, 6, 6, 6});
+            CHECK(a.runs == 2);
+        }
+    }
+
+    GIVEN("node changed while a run is processed in parts") {
+        c.value = 5;
+        c.makeDirty();
+
+        plan->begin(info, out.size());
+        plan->process(std::array{std::span(out).first(2)});
+
+        c.makeDirty();
+
+        plan->process(std::array{std::span(out).subspan(2)});
+        plan->finish();
+
+        THEN("the run is complete and the later change is processed by the next one") {
+            CHECK(out == std::array<types::Float, 4>{8, 8, 8, 8});
+            CHECK(c.runs == 3);
+
+            plan->run(info, out);
+            CHECK(c.runs == 4);
+        }
+    }
+}
+
+SCENARIO("Signal metadata") {
+    using Role = Attachment::Role;
+
+    auto constant = [](types::Float v) {
+        auto node = nodes::value();
+        node->deserializeData({{"type", 0}, {"value", v}});
+        return node;
+    };
+
+    Sink sink;
+
+    GIVEN("constant feeding a kernel that reads samples") {
+        auto three = constant(3);
+        Add add;
+
+        add.x.attach(port(*three, Role::OUTPUT));
+        sink.input.attach(add.output);
+
+        THEN("constant is materialized") {
+            std::array<types::Float, 4> out{};
+            engine::Plan::compile(sink.input)->run(info, out);
+            CHECK(out == std::array<types::Float, 4>{3, 3, 3, 3});
+        }
+    }
+
+    GIVEN("math on constants") {
+        auto two = constant(2), three = constant(3);
+        auto mul = nodes::math();
+
+        port(*mul, Role::INPUT, 0).attach(port(*two, Role::OUTPUT));
+        port(*mul, Role::INPUT, 1).attach(port(*three, Role::OUTPUT));
+        sink.input.attach(port(*mul, Role::OUTPUT));
+
+        THEN("result is folded") {
+            std::array<types::Float, 4> out{};
+            engine::Plan::compile(sink.input)->run({.sample_rate = 44100, .block_size = 3}, out);
+            CHECK(out == std::array<types::Float, 4>{6, 6, 6, 6});
+        }
+    }
+
+    GIVEN("filter fed with silence") {
+        auto silence = constant(0);
+        auto biquad = nodes::biQuadFilter();
+
+        port(*biquad, Role::INPUT).attach(port(*silence, Role::OUTPUT));
+        sink.input.attach(port(*biquad, Role::OUTPUT));
+
+        THEN("output is silent") {
+            std::array<types::Float, 4> out{1, 1, 1, 1};
+            engine::Plan::compile(sink.input)->run(info, out);
+            CHECK(out == std::array<types::Float, 4>{0, 0, 0, 0});
+        }
+    }
+
+    GIVEN("generators driven by a constant and by a dense frequency") {
+        auto hz = constant(440);
+        Source dense_hz(440);
+        auto ramp = nodes::generator(), dense = nodes::generator();
+
+        port(*ramp, Role::INPUT).attach(port(*hz, Role::OUTPUT));
+        port(*dense, Role::INPUT).attach(dense_hz.output);
+
+        THEN("closed-form phase matches the accumulated one") {
+            std::vector<types::Float> a(2000), b(2000);
+
+            sink.input.attach(port(*ramp, Role::OUTPUT));
+            engine::Plan::compile(sink.input)->run(info, a);
+            sink.input.attach(port(*dense, Role::OUTPUT));
+            engine::Plan::compile(sink.input)->run(info, b);
+
+            types::Float max_error = 0;
+
+            for (size_t i = 0; i < a.size(); ++i) {
+                max_error = std::max(max_error, std::abs(a[i] - b[i]));
+            }
+
+            CHECK(max_error < 1e-3f);
+        }
+    }
+}
+
+SCENARIO("Control rate") {
+    using Role = Attachment::Role;
+
+    auto envelope = nodes::envelope();
+    auto gain = nodes::value();
+    auto mul = nodes::math();
+    Sink sink;
+
+    gain->deserializeData({{"type", 0}, {"value", 2.f}});
+    port(*mul, Role::INPUT, 0).attach(port(*envelope, Role::OUTPUT));
+    port(*mul, Role::INPUT, 1).attach(port(*gain, Role::OUTPUT));
+    sink.input.attach(port(*mul, Role::OUTPUT));
+
+    auto plan = engine::Plan::compile(sink.input);
+    REQUIRE(plan.has_value());
+
+    std::vector<types::Float> audio_rate(40000);
+    plan->run({.sample_rate = 44100, .control_period = 0}, audio_rate);
+
+    for (const auto period : {1, 32, 64}) {
+        GIVEN("control period " + std::to_string(period)) {
+            std::vector<types::Float> control_rate(audio_rate.size());
+            plan->run({.sample_rate = 44100, .control_period = static_cast<size_t>(period)}, control_rate);
+
+            THEN("interpolated modulation follows the audio-rate one, corners are cut within a period") {
+                types::Float max_error = 0;
+
+                for (size_t i = 0; i < audio_rate.size(); ++i) {
+                    max_error = std::max(max_error, std::abs(audio_rate[i] - control_rate[i]));
+                }
+
+                // steepest default segment rises by 2 (with gain) in 441 samples
+                CHECK(max_error < static_cast<types::Float>(period) / 441);
+                CHECK(control_rate.back() == 0);
+            }
+        }
+    }
+
+    GIVEN("control points") {
+        const std::array<types::Float, 3> points{0, 32, 0};
+        std::array<types::Float, 34> samples{};
+
+        nodes::interpolateControl(points, 30, 32, samples);
+
+        THEN("samples are interpolated between the surrounding points") {
+            CHECK(samples[0] == 30);
+            CHECK(samples[1] == 31);
+            CHECK(samples[2] == 32);
+            CHECK(samples[3] == 31);
+            CHECK(nodes::controlPointCount(30, samples.size(), 32) == points.size());
+        }
+    }
+}
+
+SCENARIO("Block streaming") {
+    using Role = Attachment::Role;
+
+    auto hz = nodes::value();
+    auto generator = nodes::generator();
+    auto envelope = nodes::envelope();
+    auto gain = nodes::math();
+    auto comb = nodes::combFilter();
+    auto biquad = nodes::biQuadFilter();
+    Sink sink;
+
+    hz->deserializeData({{"type", 0}, {"value", 440.f}});
+
+    port(*generator, Role::INPUT).attach(port(*hz, Role::OUTPUT));
+    port(*gain, Role::INPUT, 0).attach(port(*generator, Role::OUTPUT));
+    port(*gain, Role::INPUT, 1).attach(port(*envelope, Role::OUTPUT));
+    port(*comb, Role::INPUT).attach(port(*gain, Role::OUTPUT));
+    port(*biquad, Role::INPUT).attach(port(*comb, Role::OUTPUT));
+    sink.input.attach(port(*biquad, Role::OUTPUT));
+
+    auto plan = engine::Plan::compile(sink.input);
+    REQUIRE(plan.has_value());
+
+    std::vector<types::Float> one_shot(20000);
+    plan->run({.sample_rate = 44100, .block_size = one_shot.size()}, one_shot);
+
+    REQUIRE(std::ranges::any_of(one_shot, [](types::Float v) { return v != 0; }));
+
+    for (const auto block_size : {1, 7, 64, 512}) {
+        GIVEN("block size " + std::to_string(block_size)) {
+            std::vector<types::Float> blocks(one_shot.size());
+            plan->run({.sample_rate = 44100, .block_size = static_cast<size_t>(block_size)}, blocks);
+
+            THEN("output is identical to a one-shot render") { CHECK(blocks == one_shot); }
+        }
+    }
+
+    GIVEN("stream rendered in consecutive calls") {
+        std::vector<types::Float> stream(one_shot.size());
+        plan->prepare({.sample_rate = 44100, .block_size = 100});
+
+        for (size_t offset = 0; offset < stream.size(); offset += 1000) {
+            const std::array outputs{std::span(stream).subspan(offset, 1000)};
+            plan->process(outputs);
+        }
+
+        THEN("output is identical to a one-shot render") { CHECK(stream == one_shot); }
+    }
+}
+
+SCENARIO("Live stream") {
+    using Role = Attachment::Role;
+
+    auto hz = nodes::value();
+    auto generator = nodes::generator();
+    auto envelope = nodes::envelope();
+    auto gain = nodes::math();
+    Sink sink;
+
+    hz->deserializeData({{"type", 0}, {"value", 440.f}});
+
+    port(*generator, Role::INPUT).attach(port(*hz, Role::OUTPUT));
+    port(*gain, Role::INPUT, 0).attach(port(*generator, Role::OUTPUT));
+    port(*gain, Role::INPUT, 1).attach(port(*envelope, Role::OUTPUT));
+    sink.input.attach(port(*gain, Role::OUTPUT));
+
+    const RenderInfo live_info = {.sample_rate = 44100, .block_size = 256};
+
+    std::vector<types::Float> offline(10000);
+    engine::Plan::compile(sink.input)->run(live_info, offline);
+
+    GIVEN("stream pulled in device sized chunks") {
+        auto stream = engine::Stream::create(sink.input, live_info);
+        REQUIRE(stream != nullptr);
+
+        std::vector<types::Float> live(offline.size());
+
+        for (size_t offset = 0; offset < live.size(); offset += 100) {
+            stream->render(std::span(live).subspan(offset, 100));
+        }
+
+        THEN("output is identical to an offline render") { CHECK(live == offline); }
+
+
+        THEN("stream becomes outdated when the topology changes") {
+            sink.input.detach();
+            CHECK(stream->isOutdated());
+        }
+    }
+
+    GIVEN("parameter changed while the stream plays") {
+        auto stream = engine::Stream::create(sink.input, live_info);
+
+        std::vector<types::Float> live(offline.size());
+        stream->render(std::span(live).first(1000));
+
+        hz->deserializeData({{"type", 0}, {"value", 220.f}});
+        hz->makeDirty();
+
+        THEN("the stream keeps its parameters until they are published") {
+            stream->render(std::span(live).subspan(1000));
+            CHECK(live == offline);
+        }
+
+        THEN("published parameters apply from the next block on, without restarting the stream") {
+            stream->update();
+            stream->render(std::span(live).subspan(1000));
+
+            CHECK(!stream->isOutdated());
+            CHECK(std::ranges::equal(std::span(live).first(1024), std::span(offline).first(1024)));
+            CHECK(!std::ranges::equal(std::span(live).subspan(1024, 256), std::span(offline).subspan(1024, 256)));
+        }
+    }
+
+    GIVEN("stream started at a position") {
+        sink.input.attach(port(*envelope, Role::OUTPUT));
+        engine::Plan::compile(sink.input)->run(live_info, offline);
+
+        auto stream = engine::Stream::create(sink.input, live_info, 4000);
+
+        std::vector<types::Float> live(offline.size() - 4000);
+        stream->render(live);
+
+        THEN("time based nodes continue from that position") { CHECK(std::ranges::equal(live, std::span(offline).subspan(4000))); }
+    }
+
+    GIVEN("graph with a cycle") {
+        Add add_1, add_2;
+        add_1.x.attach(add_2.output);
+        add_2.x.attach(add_1.output);
+        sink.input.attach(add_1.output);
+
+        THEN("no stream is created") { CHECK(engine::Stream::create(sink.input, live_info) == nullptr); }
+    }
+}
+
+SCENARIO("Background rendering") {
+    using Role = Attachment::Role;
+
+    auto hz = nodes::value();
+    auto generator = nodes::generator();
+    auto biquad = nodes::biQuadFilter();
+    Sink sink;
+
+    hz->deserializeData({{"type", 0}, {"value", 440.f}});
+
+    port(*generator, Role::INPUT).attach(port(*hz, Role::OUTPUT));
+    port(*biquad, Role::INPUT).attach(port(*generator, Role::OUTPUT));
+    sink.input.attach(port(*biquad, Role::OUTPUT));
+
+    std::vector<types::Float> expected(50000);
+    engine::InputRenderer(sink.input).render(info, expected);
+
+    auto renderer = engine::InputRenderer(sink.input, true);
+    engine::RenderJob job;
+
+    auto wait = [&job] {
+        while (!job.poll()) {
+            std::this_thread::yield();
+        }
+    };
+
+    GIVEN("job left to complete") {
+        job.start(renderer, info, expected.size());
+        wait();
+
+        THEN("the clip matches a synchronous render") {
+            CHECK(!job.isRunning());
+            CHECK(job.progress() == 1.f);
+            CHECK(std::ranges::equal(job.clip().samples(), expected));
+        }
+    }
+
+    GIVEN("node edited while the job runs") {
+        job.start(renderer, info, expected.size());
+        hz->deserializeData({{"type", 0}, {"value", 220.f}});
+        hz->makeDirty();
+        wait();
+
+        THEN("the job renders the graph as it was at the start") { CHECK(std::ranges::equal(job.clip().samples(), expected)); }
+    }
+
+    GIVEN("job cancelled") {
+        job.start(renderer, info, expected.size());
+        job.cancel();
+
+        THEN("the clip stays incomplete and the next job renders everything again") {
+            CHECK(!job.isRunning());
+            CHECK(!job.poll());
+
+            job.start(renderer, info, expected.size());
+            wait();
+
+            CHECK(std::ranges::equal(job.clip().samples(), expected));
+        }
+    }
+
+    GIVEN("draft job at a quarter of the rate") {
+        auto draft_info = info;
+        draft_info.sample_rate /= 4;
+
+        std::vector<types::Float> draft(expected.size() / 4 + 1);
+        engine::InputRenderer(sink.input).render(draft_info, draft);
+
+        job.start(renderer, draft_info, expected.size(), nullptr, 4);
+        wait();
+
+        THEN("the clip interpolates a render at the lower rate") {
+            const auto samples = job.clip().samples();
+            REQUIRE(samples.size() == expected.size());
+
+            size_t mismatches = 0;
+
+            for (size_t i = 0; i < samples.size(); ++i) {
+                const auto prev = draft[i / 4];
+                const auto next = draft[i / 4 + 1];
+                mismatches += samples[i] != prev + (next - prev) * static_cast<types::Float>(i % 4) / static_cast<types::Float>(4);
+            }
+
+            CHECK(mismatches == 0);
+        }
+    }
+}
+
+SCENARIO("Parallel execution") {
+    using Role = Attachment::Role;
+
+    engine::ThreadPool pool(3);
+
+    GIVEN("thread pool") {
+        std::atomic<size_t> pending = 1000;
+        std::vector<std::atomic<size_t>> hits(1000);
+
+        struct Data {
+            std::atomic<size_t> &pending;
+            std::vector<std::atomic<size_t>> &hits;
+        } data{pending, hits};
+
+        for (size_t i = 0; i < hits.size(); ++i) {
+            pool.push({
+                .fn = [](void *data, size_t index) {
+                    auto &d = *static_cast<Data *>(data);
+                    d.hits[index] += 1;
+                    d.pending -= 1;
+                },
+                .data = &data,
+                .index = i,
+            });
+        }
+
+        pool.wait(pending);
+
+        THEN("every task runs exactly once") {
+            CHECK(std::ranges::all_of(hits, [](const auto &hit) { return hit == 1; }));
+        }
+    }
+
+    GIVEN("independent voices mixed together") {
+        std::vector<std::unique_ptr<INode>> nodes;
+        Sink sink;
+
+        auto make = [&nodes](auto factory) -> INode & { return *nodes.emplace_back(factory()); };
+
+        Attachment *mix = nullptr;
+
+        for (size_t i = 0; i < 8; ++i) {
+            auto &hz = make(nodes::value);
+            auto &generator = make(nodes::generator);
+            auto &comb = make(nodes::combFilter);
+
+            hz.deserializeData({{"type", 0}, {"value", 110.f * (i + 1)}});
+            port(generator, Role::INPUT).attach(port(hz, Role::OUTPUT));
+            port(comb, Role::INPUT).attach(port(generator, Role::OUTPUT));
+
+            if (mix == nullptr) {
+                mix = &port(comb, Role::OUTPUT);
+                continue;
+            }
+
+            auto &add = make(nodes::math);
+            port(add, Role::INPUT, 0).attach(*mix);
+            port(add, Role::INPUT, 1).attach(port(comb, Role::OUTPUT));
+            mix = &port(add, Role::OUTPUT);
+        }
+
+        sink.input.attach(*mix);
+
+        auto plan = engine::Plan::compile(sink.input);
+        REQUIRE(plan.has_value());
+        CHECK(plan->width() == 8);
+
+        const auto render_info = RenderInfo{.sample_rate = 44100, .block_size = 256};
+
+        std::vector<types::Float> serial(10000);
+        plan->run(render_info, serial);
+
+        REQUIRE(std::ranges::any_of(serial, [](types::Float v) { return v != 0; }));
+
+        THEN("output is identical to a serial render") {
+            for (size_t i = 0; i < 4; ++i) {
+                std::vector<types::Float> parallel(serial.size());
+                plan->run(render_info, parallel, &pool);
+
+                CHECK(parallel == serial);
+            }
+        }
+    }
+}
@@ -1,9 +1,13 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_floating_point.hpp>
 
 #include <audio/filters.hpp>
 
+#include <cmath>
+#include <cstdint>
 #include <ranges>
+#include <vector>
 
 SCENARIO("DelayGroup") {
     GIVEN("static delay group") {
@@ -40,6 +44,29 @@ SCENARIO("DelayGroup") {
             }
         }
     }
+
+    GIVEN("long delay group") {
+        static constexpr auto dg_size = 100;
+        auto dg = audio::DelayGroup<float, dg_size>{};
+
+        THEN("values are pushed in order across wraparounds") {
+            for (auto i = 0; i < dg_size * 3; ++i) {
+                dg.push(i);
+            }
+
+            for (auto i = 0; i < dg_size; ++i) {
+                CHECK(dg[i] == dg_size * 3 - 1 - i);
+            }
+
+            AND_THEN("reset fills all registers") {
+                dg.reset(5);
+
+                for (const auto &v : dg) {
+                    CHECK(v == 5);
+                }
+            }
+        }
+    }
 }
 
 SCENARIO("simple RecursiveLinearFilters") {
@@ -170,3 +197,235 @@ SCENARIO("BiQuadFilter") {
         }
     }
 }
+
+namespace {
+// deterministic noise with some low frequency content, exercises all coefficients
+std::vector<float> testSignal(size_t size) {
+    std::vector<float> signal(size);
+    uint32_t state = 1;
+
+    for (size_t i = 0; i < size; ++i) {
+        state = state * 1664525u + 1013904223u;
+        signal[i] = static_cast<float>(state >> 8) / static_cast<float>(1 << 24) - 0.5f + 0.5f * std::sin(static_cast<float>(i) * 0.01f);
+    }
+
+    return signal;
+}
+} // namespace
+
+SCENARIO("Block BiQuadFilters") {
+    const auto params = audio::filter::peak<float>(44100, 1000, 2, 6);
+    const auto input = testSignal(1003);
+
+    std::vector<float> expected(input.size());
+    audio::BiQuadFilter<float> scalar(params);
+
+    for (const auto [i, e] : std::ranges::views::zip(input, expected)) {
+        e = scalar.process(i);
+    }
+
+    auto checkBlockFilter = [&](auto filter) {
+        std::vector<float> output(input.size());
+
+        THEN("the output matches the scalar filter, also when processed in parts") {
+            const auto split = std::span(input).first(501);
+
+            filter.process(split, std::span(output).first(split.size()));
+            filter.process(std::span(input).subspan(split.size()), std::span(output).subspan(split.size()));
+
+            for (const auto [o, e] : std::ranges::views::zip(output, expected)) {
+                CHECK_THAT(o, Catch::Matchers::WithinAbs(e, 1e-5));
+            }
+        }
+
+        THEN("the output may replace the input") {
+            output = input;
+            filter.process(output, output);
+
+            for (const auto [o, e] : std::ranges::views::zip(output, expected)) {
+                CHECK_THAT(o, Catch::Matchers::WithinAbs(e, 1e-5));
+            }
+        }
+
+        THEN("reset brings the filter to rest") {
+            filter.process(input, output);
+            CHECK(!filter.isAtRest());
+
+            filter.reset();
+            CHECK(filter.isAtRest());
+        }
+    };
+
+    GIVEN("transposed direct form II") { checkBlockFilter(audio::BlockBiQuadFilter<float>(params)); }
+    GIVEN("state space, 4 samples at once") { checkBlockFilter(audio::StateSpaceBiQuadFilter<float, 4>(params)); }
+    GIVEN("state space, 8 samples at once") { checkBlockFilter(audio::StateSpaceBiQuadFilter<float, 8>(params)); }
+    GIVEN("state space, 16 samples at once") { checkBlockFilter(audio::StateSpaceBiQuadFilter<float, 16>(params)); }
+}
+
+TEST_CASE("BiQuadFilter throughput, 65536 samples per run", "[.][benchmark]") {
+    const auto params = audio::filter::lowPass<float>(44100, 1000, 0.7);
+    const auto input = testSignal(65536);
+    std::vector<float> output(input.size());
+
+    BENCHMARK("scalar RecursiveLinearFilter") {
+        audio::BiQuadFilter<float> filter(params);
+
+        for (const auto [i, o] : std::ranges::views::zip(input, output)) {
+            o = filter.process(i);
+        }
+
+        return output.back();
+    };
+
+    BENCHMARK("BlockBiQuadFilter") {
+        audio::BlockBiQuadFilter<float> filter(params);
+        filter.process(input, output);
+        return output.back();
+    };
+
+    BENCHMARK("StateSpaceBiQuadFilter<4>") {
+        audio::StateSpaceBiQuadFilter<float, 4> filter(params);
+        filter.process(input, output);
+        return output.back();
+    };
+
+    BENCHMARK("StateSpaceBiQuadFilter<8>") {
+        audio::StateSpaceBiQuadFilter<float, 8> filter(params);
+        filter.process(input, output);
+        return output.back();
+    };
+
+    BENCHMARK("StateSpaceBiQuadFilter<16>") {
+        audio::StateSpaceBiQuadFilter<float, 16> filter(params);
+        filter.process(input, output);
+        return output.back();
+    };
+}
+
+SCENARIO("MultiBiQuadFilter") {
+    const auto input = testSignal(1003);
+
+    const std::array params = {
+        audio::filter::lowPass<float>(44100, 500, 0.7),
+        audio::filter::highPass<float>(44100, 2000, 0.7),
+        audio::filter::peak<float>(44100, 1000, 2, 6),
+        audio::filter::highShelf<float>(44100, 5000, 0.7, -6),
+    };
+
+    std::array<std::vector<float>, params.size()> expected;
+
+    for (const auto [p, e] : std::ranges::views::zip(params, expected)) {
+        audio::BiQuadFilter<float> scalar(p);
+
+        for (const auto i : input) {
+            e.push_back(scalar.process(i));
+        }
+    }
+
+    GIVEN("one signal at four settings") {
+        audio::MultiBiQuadFilter<float, 4> filter(params.front());
+
+        for (size_t lane = 0; lane < params.size(); ++lane) {
+            filter.setup(lane, params[lane]);
+        }
+
+        std::vector<audio::MultiBiQuadFilter<float, 4>::Frame> output(input.size());
+        filter.process(input, output);
+
+        THEN("every lane matches the scalar filter with its parameters") {
+            for (size_t i = 0; i < input.size(); ++i) {
+                for (size_t lane = 0; lane < params.size(); ++lane) {
+                    CHECK_THAT(output[i][lane], Catch::Matchers::WithinAbs(expected[lane][i], 1e-5));
+                }
+            }
+        }
+
+        THEN("resetting a lane leaves the others running") {
+            filter.reset(0);
+            CHECK(!filter.isAtRest());
+
+            // lane 0 starts over, the others continue from the first signal
+            std::vector<audio::BiQuadFilter<float>> scalars;
+
+            for (const auto &p : params) {
+                auto &scalar = scalars.emplace_back(p);
+
+                for (const auto i : input) {
+                    scalar.process(i);
+                }
+            }
+
+            scalars[0].reset();
+
+            const auto tail = testSignal(257);
+            std::vector<audio::MultiBiQuadFilter<float, 4>::Frame> tail_output(tail.size());
+            filter.process(tail, tail_output);
+
+            for (size_t i = 0; i < tail.size(); ++i) {
+                for (size_t lane = 0; lane < params.size(); ++lane) {
+                    CHECK_THAT(tail_output[i][lane], Catch::Matchers::WithinAbs(scalars[lane].process(tail[i]), 1e-5));
+                }
+            }
+
+            filter.reset();
+            CHECK(filter.isAtRest());
+        }
+    }
+
+    GIVEN("eight channels filtered in place, frame by frame") {
+        audio::MultiBiQuadFilter<float, 8> filter(params[2]);
+        std::vector<audio::MultiBiQuadFilter<float, 8>::Frame> frames(input.size());
+
+        // every channel is the signal scaled by its index
+        for (const auto [i, f] : std::ranges::views::zip(input, frames)) {
+            for (size_t lane = 0; lane < f.size(); ++lane) {
+                f[lane] = i * static_cast<float>(lane);
+            }
+        }
+
+        filter.process(std::span(frames).first(100), std::span(frames).first(100));
+
+        for (auto &f : std::span(frames).subspan(100)) {
+            f = filter.process(f);
+        }
+
+        THEN("every channel matches the scalar filter") {
+            for (size_t i = 0; i < input.size(); ++i) {
+                for (size_t lane = 0; lane < frames[i].size(); ++lane) {
+                    CHECK_THAT(frames[i][lane], Catch::Matchers::WithinAbs(expected[2][i] * static_cast<float>(lane), 1e-4));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("MultiBiQuadFilter throughput, 16 streams of 4096 samples per run", "[.][benchmark]") {
+    constexpr size_t lanes = 16;
+
+    const auto params = audio::filter::lowPass<float>(44100, 1000, 0.7);
+    const auto input = testSignal(4096);
+
+    BENCHMARK("16 scalar RecursiveLinearFilters") {
+        std::vector<float> output(input.size());
+        float sum = 0;
+
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            audio::BiQuadFilter<float> filter(params);
+
+            for (const auto [i, o] : std::ranges::views::zip(input, output)) {
+                o = filter.process(i);
+            }
+
+            sum += output.back();
+        }
+
+        return sum;
+    };
+
+    BENCHMARK("MultiBiQuadFilter<16>") {
+        std::vector<audio::MultiBiQuadFilter<float, lanes>::Frame> output(input.size());
+        audio::MultiBiQuadFilter<float, lanes> filter(params);
+        filter.process(input, output);
+        return output.back().back();
+    };
+}
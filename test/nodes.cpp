@@ -3,6 +3,9 @@
 #include <nodes/nodes.hpp>
 #include <nodes/serialization.hpp>
 
+#include <algorithm>
+#include <array>
+
 using namespace nodes;
 
 SCENARIO("AttachmentPoint") {
@@ -10,13 +13,13 @@ SCENARIO("AttachmentPoint") {
         struct Node : public INode {
             Node(std::string name) : INode(std::move(name), 0, 0) {}
 
-            void process(Ctx &, std::span<float>) override {}
+            std::unique_ptr<Kernel> createKernel() override { return nullptr; }
             void ui(Ctx &) override {}
 
             void serializeData(nlohmann::json &) override {}
             void deserializeData(const nlohmann::json &) override {}
 
-            Attachments attachments(Attachments , AttachmentFilter ) override { return {}; }
+            Attachments listAttachments() override { return {}; }
         };
     };
 
@@ -68,13 +71,38 @@ SCENARIO("AttachmentPoint") {
             }
         }
 
-        AND_WHEN("Another AP breaks attachment") {
+        AND_WHEN("Another input AP attaches to the same output") {
             c1.attach(b1);
 
-            THEN("First connection is broken and new is created") {
-                REQUIRE(a1.attached() == nullptr);
-                REQUIRE(b1.attached() == &c1);
+            THEN("Output AP feeds both inputs") {
+                REQUIRE(a1.attached() == &b1);
                 REQUIRE(c1.attached() == &b1);
+                REQUIRE(b1.peers().size() == 2);
+                REQUIRE(b1.peers()[0] == &a1);
+                REQUIRE(b1.peers()[1] == &c1);
+            }
+
+            AND_WHEN("Output AP is detached") {
+                b1.detach();
+
+                THEN("All APs become detached") {
+                    REQUIRE(a1.attached() == nullptr);
+                    REQUIRE(b1.attached() == nullptr);
+                    REQUIRE(c1.attached() == nullptr);
+                }
+            }
+        }
+
+        AND_WHEN("Input AP attaches to another output") {
+            impl::Node nd("nd");
+            Attachment d1(&nd, Attachment::Role::OUTPUT, "ndp");
+            c1.attach(d1);
+            a1.attach(d1);
+
+            THEN("Previous connection of the input is broken") {
+                REQUIRE(a1.attached() == &d1);
+                REQUIRE(b1.attached() == nullptr);
+                REQUIRE(d1.peers().size() == 2);
             }
         }
 
@@ -94,12 +122,10 @@ SCENARIO("INode") {
         struct AudioOutput : public INode {
             AudioOutput() : INode("Audio Output", 0, 0) {}
 
-            void process(Ctx &, std::span<float>) override {}
+            std::unique_ptr<Kernel> createKernel() override { return nullptr; }
             void ui(Ctx &) override {}
 
-            Attachments attachments(Attachments buffer, AttachmentFilter filter) override { //
-                return implAttachments(buffer, filter, &input);
-            }
+            Attachments listAttachments() override { return {&input}; }
 
             void serializeData(nlohmann::json &) override {}
             void deserializeData(const nlohmann::json &) override {}
@@ -110,12 +136,10 @@ SCENARIO("INode") {
         struct Generator : public INode {
             Generator() : INode("Generator", 0, 0) {}
 
-            void process(Ctx &, std::span<float>) override {}
+            std::unique_ptr<Kernel> createKernel() override { return nullptr; }
             void ui(Ctx &) override {}
 
-            Attachments attachments(Attachments buffer, AttachmentFilter filter) override { //
-                return implAttachments(buffer, filter, &output);
-            }
+            Attachments listAttachments() override { return {&output}; }
 
             void serializeData(nlohmann::json &) override {}
             void deserializeData(const nlohmann::json &) override {}
@@ -131,13 +155,13 @@ SCENARIO("INode") {
     INode &i_output = output;
 
     THEN("Generator has one output AP") {
-        const auto outputs = i_generator.attachments({}, Attachment::Role::OUTPUT);
+        const auto outputs = i_generator.attachments(Attachment::Role::OUTPUT);
 
         CHECK(outputs.size() == 1);
         CHECK(outputs.at(0)->name == "Out");
         CHECK(outputs.at(0)->role == Attachment::Role::OUTPUT);
 
-        const auto inputs = i_generator.attachments({}, Attachment::Role::INPUT);
+        const auto inputs = i_generator.attachments(Attachment::Role::INPUT);
 
         CHECK(inputs.size() == 0);
 
@@ -149,11 +173,11 @@ SCENARIO("INode") {
     }
 
     THEN("AudioOutput has one input AP") {
-        const auto outputs = i_output.attachments({}, Attachment::Role::OUTPUT);
+        const auto outputs = i_output.attachments(Attachment::Role::OUTPUT);
 
         CHECK(outputs.size() == 0);
 
-        const auto inputs = i_output.attachments({}, Attachment::Role::INPUT);
+        const auto inputs = i_output.attachments(Attachment::Role::INPUT);
 
         CHECK(inputs.size() == 1);
         CHECK(inputs.at(0)->name == "In");
@@ -165,4 +189,128 @@ SCENARIO("INode") {
         CHECK(all.at(0)->name == "In");
         CHECK(all.at(0)->role == Attachment::Role::INPUT);
     }
+
+    THEN("edits are counted per node and for the whole graph") {
+        output.input.attach(generator.output);
+
+        const auto node_revision = i_generator.revision();
+        const auto edit_revision = nodes::editRevision();
+
+        i_generator.makeDirty();
+
+        CHECK(i_generator.revision() == node_revision + 1);
+        CHECK(nodes::editRevision() == edit_revision + 1);
+        CHECK(i_output.isDirty());
+    }
+}
+
+SCENARIO("Attachment cache") {
+    auto splitter = nodes::splitter();
+
+    const auto &outputs = splitter->attachments(Attachment::Role::OUTPUT);
+    const auto data = outputs.data();
+
+    THEN("repeated queries return the same list") {
+        CHECK(&splitter->attachments(Attachment::Role::OUTPUT) == &outputs);
+        CHECK(splitter->attachments(Attachment::Role::OUTPUT).data() == data);
+    }
+
+    WHEN("port set changes") {
+        splitter->deserializeData({{"size", 3}});
+
+        THEN("list is rebuilt") {
+            CHECK(splitter->attachments(Attachment::Role::OUTPUT).size() == 3);
+            CHECK(splitter->attachments(Attachment::Role::INPUT).size() == 1);
+            CHECK(splitter->attachments().size() == 4);
+        }
+    }
+}
+
+SCENARIO("Deserialization") {
+    GIVEN("comb filter saved with a delay longer than its history") {
+        auto comb = nodes::combFilter();
+        comb->deserializeData({{"fb_delay", 5.0}});
+
+        THEN("delay is clamped like in the UI") {
+            nlohmann::json json;
+            comb->serializeData(json);
+
+            CHECK(json["fb_delay"].get<types::Float>() < 1.f);
+        }
+    }
+}
+
+SCENARIO("Topology") {
+    struct Node : public INode {
+        Node() : INode("Node", 0, 0) {}
+
+        std::unique_ptr<Kernel> createKernel() override { return nullptr; }
+        void ui(Ctx &) override {}
+
+        void serializeData(nlohmann::json &) override {}
+        void deserializeData(const nlohmann::json &) override {}
+
+        Attachments listAttachments() override { return {&x, &y, &output, &impulse}; }
+
+        Attachment x = Attachment(this, Attachment::Role::INPUT, "X");
+        Attachment y = Attachment(this, Attachment::Role::INPUT, "Y");
+        Attachment output = Attachment(this, Attachment::Role::OUTPUT, "Out");
+        Attachment impulse = Attachment(this, Attachment::Role::OUTPUT, "Impulse", true);
+    };
+
+    GIVEN("deep chain of reconvergent diamonds") {
+        // every node feeds both inputs of the next one, so the chain has 2^depth paths
+        std::array<Node, 64> chain;
+
+        for (size_t i = 1; i < chain.size(); ++i) {
+            chain[i].x.attach(chain[i - 1].output);
+            chain[i].y.attach(chain[i - 1].output);
+        }
+
+        THEN("traversals visit nodes instead of paths") {
+            CHECK_FALSE(chain.back().isChainInfinite().has_value());
+
+            chain.front().makeDirty();
+            CHECK(std::ranges::all_of(chain, [](const Node &node) { return node.isDirty(); }));
+        }
+
+        THEN("topological order puts producers first") {
+            const auto order = topologicalOrder();
+            auto position = [&order](const INode *node) { return std::ranges::find(order, node) - order.begin(); };
+
+            for (size_t i = 1; i < chain.size(); ++i) {
+                CHECK(position(&chain[i - 1]) < position(&chain[i]));
+            }
+        }
+    }
+
+    GIVEN("loop") {
+        Node a, b, c;
+
+        b.x.attach(a.output);
+        c.x.attach(b.output);
+
+        WHEN("closed through a regular output") {
+            a.x.attach(c.output);
+
+            THEN("chain is infinite") {
+                const auto stack = c.isChainInfinite();
+                REQUIRE(stack.has_value());
+                CHECK(*stack == std::vector<INode *>{&c, &b, &a, &c});
+                CHECK(std::ranges::find(topologicalOrder(), &a) == topologicalOrder().end());
+            }
+
+            AND_WHEN("loop is broken") {
+                a.x.detach();
+
+                THEN("chain is finite again") { CHECK_FALSE(c.isChainInfinite().has_value()); }
+            }
+        }
+
+        WHEN("closed through a terminating output") {
+            a.x.attach(c.impulse);
+
+            THEN("chain is finite") { CHECK_FALSE(c.isChainInfinite().has_value()); }
+        }
+    }
 }